@@ -33,17 +33,53 @@ public:
 		rec.setFaceNormal(r, outward_normal);
 
 		rec.matPtr = mp;
+		rec.object = this;
 		rec.p = r.at(t);
 
 		return true;
 	}
 
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override
+	{
+		float t = (k - r.o.x) / r.dir.x;
+		if (t < t_min || t > t_max)
+			return false;
+
+		float y = r.o.y + t * r.dir.y;
+		float z = r.o.z + t * r.dir.z;
+
+		return !(y < y0 || y > y1 || z < z0 || z > z1);
+	}
+
 	virtual bool boundingBox(AABB& outputBox) override
 	{
 		outputBox = AABB(glm::vec3(k - 0.0001, y0, z0), glm::vec3(k + 0.0001, y1, z1));
 		return true;
 	}
 
+	virtual float area() const override
+	{
+		return (y1 - y0) * (z1 - z0);
+	}
+
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override
+	{
+		surfaceSample sample;
+		sample.u = sampler.nextFloat();
+		sample.v = sampler.nextFloat();
+		sample.p = glm::vec3(k, y0 + sample.u * (y1 - y0), z0 + sample.v * (z1 - z0));
+		sample.normal = glm::vec3(1, 0, 0);
+
+		return sample;
+	}
+
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override
+	{
+		axis = glm::vec3(1, 0, 0);
+		cosTheta = 1.0f;
+		return true;
+	}
+
 private:
 	float y0, y1, z0, z1, k;
 	std::shared_ptr<Material> mp;
@@ -80,17 +116,53 @@ public:
 		rec.setFaceNormal(r, outward_normal);
 
 		rec.matPtr = mp;
+		rec.object = this;
 		rec.p = r.at(t);
 
 		return true;
 	}
 
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override
+	{
+		float t = (k - r.o.y) / r.dir.y;
+		if (t < t_min || t > t_max)
+			return false;
+
+		float x = r.o.x + t * r.dir.x;
+		float z = r.o.z + t * r.dir.z;
+
+		return !(x < x0 || x > x1 || z < z0 || z > z1);
+	}
+
 	virtual bool boundingBox(AABB& outputBox) override
 	{
 		outputBox = AABB(glm::vec3(x0, k - 0.0001, z0), glm::vec3(x1, k + 0.0001, z1));
 		return true;
 	}
 
+	virtual float area() const override
+	{
+		return (x1 - x0) * (z1 - z0);
+	}
+
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override
+	{
+		surfaceSample sample;
+		sample.u = sampler.nextFloat();
+		sample.v = sampler.nextFloat();
+		sample.p = glm::vec3(x0 + sample.u * (x1 - x0), k, z0 + sample.v * (z1 - z0));
+		sample.normal = glm::vec3(0, 1, 0);
+
+		return sample;
+	}
+
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override
+	{
+		axis = glm::vec3(0, 1, 0);
+		cosTheta = 1.0f;
+		return true;
+	}
+
 private:
 	float x0, x1, z0, z1, k;
 	std::shared_ptr<Material> mp;
@@ -127,17 +199,53 @@ public:
 		rec.setFaceNormal(r, outward_normal);
 
 		rec.matPtr = mp;
+		rec.object = this;
 		rec.p = r.at(t);
 
 		return true;
 	}
 
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override
+	{
+		float t = (k - r.o.z) / r.dir.z;
+		if (t < t_min || t > t_max)
+			return false;
+
+		float x = r.o.x + t * r.dir.x;
+		float y = r.o.y + t * r.dir.y;
+
+		return !(x < x0 || x > x1 || y < y0 || y > y1);
+	}
+
 	virtual bool boundingBox(AABB& outputBox) override
 	{
 		outputBox = AABB(glm::vec3(x0, y0, k - 0.0001f), glm::vec3(x1, y1, k + 0.0001f));
 		return true;
 	}
 
+	virtual float area() const override
+	{
+		return (x1 - x0) * (y1 - y0);
+	}
+
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override
+	{
+		surfaceSample sample;
+		sample.u = sampler.nextFloat();
+		sample.v = sampler.nextFloat();
+		sample.p = glm::vec3(x0 + sample.u * (x1 - x0), y0 + sample.v * (y1 - y0), k);
+		sample.normal = glm::vec3(0, 0, 1);
+
+		return sample;
+	}
+
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override
+	{
+		axis = glm::vec3(0, 0, 1);
+		cosTheta = 1.0f;
+		return true;
+	}
+
 private:
 	float x0, x1, y0, y1, k;
 	std::shared_ptr<Material> mp;
@@ -15,8 +15,14 @@ public:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override { return sides.occluded(r, t_min, t_max); }
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual float area() const override { return sides.area(); }
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override { return sides.sampleSurface(sampler); }
+
+	virtual std::vector<std::shared_ptr<Hittable>> split() const override { return sides.objects; }
+
 private:
 	void constructBox(glm::vec3 p0, glm::vec3 p1, std::shared_ptr<Material> matPtr);
 
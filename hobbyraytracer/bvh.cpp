@@ -3,11 +3,17 @@
 
 #include <execution>
 
+BVHNode::BVHNode(HittableList& list, std::optional<uint64_t> seed)
+{
+	PCG32 rng(seed ? *seed : std::random_device{}());
+	*this = BVHNode(list.objects, 0, list.objects.size(), rng, seed.has_value());
+}
+
 BVHNode::BVHNode(std::vector<std::shared_ptr<Hittable>>& srcObjects,
-	size_t start, size_t end)
+	size_t start, size_t end, PCG32& rng, bool deterministic)
 {
 	// Pick a random axis to compare the objects on
-	int a = glm::linearRand(0, 2);
+	int a = rng.nextInt(0, 2);
 	auto comparator = (a == 0) ? BVHNode::boxXCompare :
 		(a == 1) ? BVHNode::boxYCompare
 		: BVHNode::boxZCompare;
@@ -36,11 +42,15 @@ BVHNode::BVHNode(std::vector<std::shared_ptr<Hittable>>& srcObjects,
 	}
 	else if (noObjects != 0) // Otherwise sort the objects on the chosen axis and put them into two nodes further down the tree
 	{
-		std::sort(std::execution::par, srcObjects.begin() + start, srcObjects.begin() + end, comparator);
+		// The order a parallel sort leaves equal keys in can depend on the thread count
+		if (deterministic)
+			std::stable_sort(srcObjects.begin() + start, srcObjects.begin() + end, comparator);
+		else
+			std::sort(std::execution::par, srcObjects.begin() + start, srcObjects.begin() + end, comparator);
 
 		size_t mid = start + noObjects / 2;
-		left = std::make_shared<BVHNode>(srcObjects, start, mid);
-		right = std::make_shared<BVHNode>(srcObjects, mid, end);
+		left = std::make_shared<BVHNode>(srcObjects, start, mid, rng, deterministic);
+		right = std::make_shared<BVHNode>(srcObjects, mid, end, rng, deterministic);
 	}
 	else
 	{
@@ -77,6 +87,15 @@ bool BVHNode::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
 	return hitLeft || hitRight;
 }
 
+bool BVHNode::occluded(const ray& r, float t_min, float t_max) const
+{
+	if (!box.hit(r, t_min, t_max))
+		return false;
+
+	// Any hit will do, so the right child is only visited if the left has none
+	return left->occluded(r, t_min, t_max) || (right != left && right->occluded(r, t_min, t_max));
+}
+
 bool BVHNode::boxCompare(const std::shared_ptr<Hittable> a, const std::shared_ptr<Hittable> b, int axis)
 {
 	AABB boxA, boxB;
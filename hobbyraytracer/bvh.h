@@ -1,21 +1,25 @@
 #pragma once
 
 #include "hittableList.h"
+#include "random.h"
+
+#include <optional>
 
 class BVHNode : public Hittable
 {
 public:
 	BVHNode() { }
 
-	BVHNode(HittableList& list)
-		: BVHNode(list.objects, 0, list.objects.size())
-	{ }
+	// Passing a seed makes the build reproducible: the split axes come from that seed
+	// and objects are ordered with a sequential stable sort
+	BVHNode(HittableList& list, std::optional<uint64_t> seed = std::nullopt);
 
 	BVHNode(
 		std::vector<std::shared_ptr<Hittable>>& srcObjects,
-		size_t start, size_t end);
+		size_t start, size_t end, PCG32& rng, bool deterministic);
 
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
 private:
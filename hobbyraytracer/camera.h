@@ -1,5 +1,7 @@
 #pragma once
 
+#include "sampler.h"
+
 class Camera
 {
 public:
@@ -27,17 +29,60 @@ public:
 		lowerLeftCorner = origin - horizontal / 2.0f - vertical / 2.0f - focusDistance * w;
 
 		lensRadius = aperture / 2.0f;
+		focalDistance = focusDistance;
 	}
 
-	ray getRay(float s, float t) const
+	ray getRay(float s, float t, Sampler& sampler) const
 	{
-		// TODO: Add back in randomness
-		glm::vec2 rd = glm::vec3{ 0, 0, 0 };//glm::circularRand(lensRadius);
+		glm::vec2 rd = lensRadius * randomInUnitDisk(sampler);
 		glm::vec3 offset = u * rd.x + v * rd.y;	
 
 		return ray(origin + offset, lowerLeftCorner + s * horizontal + t * vertical - origin - offset);
 	}
 
+	// A point on the lens, uniformly by area, the origin of a pinhole camera
+	glm::vec3 sampleLens(Sampler& sampler) const
+	{
+		glm::vec2 rd = lensRadius * randomInUnitDisk(sampler);
+
+		return origin + u * rd.x + v * rd.y;
+	}
+
+	// The (s, t) getRay() takes for the ray from lensPoint through p, false if p is behind the lens
+	bool project(const glm::vec3& lensPoint, const glm::vec3& p, glm::vec2& st) const
+	{
+		glm::vec3 d = p - lensPoint;
+		float depth = glm::dot(d, -w);
+
+		if (depth <= 0.0f)
+			return false;
+
+		glm::vec3 onPlane = lensPoint + d * (focalDistance / depth) - lowerLeftCorner;
+
+		st = glm::vec2(glm::dot(onPlane, horizontal) / glm::dot(horizontal, horizontal),
+			glm::dot(onPlane, vertical) / glm::dot(vertical, vertical));
+
+		return true;
+	}
+
+	// Solid angle density of getRay() leaving along direction, when (s, t) are spread uniformly
+	// over filmArea of the focus plane. Divided by the squared distance, it's also what light
+	// reaching a sampled lens point along -direction is weighted by, as the lens' area cancels.
+	float directionPdf(const glm::vec3& direction, float filmArea) const
+	{
+		float cosTheta = glm::dot(glm::normalize(direction), -w);
+
+		if (cosTheta <= 0.0f)
+			return 0.0f;
+
+		return focalDistance * focalDistance / (filmArea * cosTheta * cosTheta * cosTheta);
+	}
+
+	// Area of the focus plane (s, t) in [0, 1] covers
+	float getViewportArea() const { return glm::length(horizontal) * glm::length(vertical); }
+
+	glm::vec3 getForward() const { return -w; }
+
 private:
 	glm::vec3 origin;
 	glm::vec3 lowerLeftCorner;
@@ -47,4 +92,5 @@ private:
 	glm::vec3 w, u, v;
 
 	float lensRadius;
+	float focalDistance = 1.0f;
 };
\ No newline at end of file
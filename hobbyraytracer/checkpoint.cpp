@@ -0,0 +1,118 @@
+#include "hobbyraytracer.h"
+#include "checkpoint.h"
+
+#include <fstream>
+
+static const char CHECKPOINT_MAGIC[8] = { 'H', 'R', 'T', 'C', 'K', 'P', 'T', '2' };
+
+template<typename T>
+static void writeVector(std::ofstream& out, const std::vector<T>& v)
+{
+	uint64_t size = v.size();
+	out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+	out.write(reinterpret_cast<const char*>(v.data()), size * sizeof(T));
+}
+
+template<typename T>
+static bool readVector(std::ifstream& in, std::vector<T>& v, uint64_t expected)
+{
+	uint64_t size = 0;
+	in.read(reinterpret_cast<char*>(&size), sizeof(size));
+
+	if (!in || size != expected)
+		return false;
+
+	v.resize(size);
+	in.read(reinterpret_cast<char*>(v.data()), size * sizeof(T));
+
+	return static_cast<bool>(in);
+}
+
+bool Checkpoint::write(const std::string& path, const checkpoint_desc& checkpoint)
+{
+	std::string temporary = path + ".tmp";
+
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out)
+		{
+			std::cout << "ERROR: Could not write checkpoint: " << temporary << std::endl;
+			return false;
+		}
+
+		const film_state& film = checkpoint.film;
+
+		out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+		out.write(reinterpret_cast<const char*>(&checkpoint.seed), sizeof(checkpoint.seed));
+		out.write(reinterpret_cast<const char*>(&film.dimensions), sizeof(film.dimensions));
+
+		writeVector(out, film.radiance);
+		writeVector(out, film.sampleCounts);
+		writeVector(out, film.luminanceSquares);
+		writeVector(out, film.splats);
+		writeVector(out, film.fixedSplats);
+
+		if (!out)
+		{
+			std::cout << "ERROR: Could not write checkpoint: " << temporary << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temporary, path, ec);
+
+	if (ec)
+	{
+		std::cout << "ERROR: Could not replace checkpoint: " << path << " (" << ec.message() << ")" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool Checkpoint::read(const std::string& path, checkpoint_desc& checkpoint)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cout << "ERROR: Could not open checkpoint: " << path << std::endl;
+		return false;
+	}
+
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+	in.read(magic, sizeof(magic));
+
+	// The last byte is the format version
+	if (in && std::equal(magic, magic + sizeof(magic) - 1, CHECKPOINT_MAGIC) && magic[sizeof(magic) - 1] != CHECKPOINT_MAGIC[sizeof(magic) - 1])
+	{
+		std::cout << "ERROR: Checkpoint was written by a different version: " << path << std::endl;
+		return false;
+	}
+
+	if (!in || !std::equal(magic, magic + sizeof(magic), CHECKPOINT_MAGIC))
+	{
+		std::cout << "ERROR: Not a checkpoint file: " << path << std::endl;
+		return false;
+	}
+
+	film_state& film = checkpoint.film;
+
+	in.read(reinterpret_cast<char*>(&checkpoint.seed), sizeof(checkpoint.seed));
+	in.read(reinterpret_cast<char*>(&film.dimensions), sizeof(film.dimensions));
+
+	uint64_t numPixels = (uint64_t)film.dimensions.x * film.dimensions.y;
+
+	if (!in
+		|| !readVector(in, film.radiance, numPixels)
+		|| !readVector(in, film.sampleCounts, numPixels)
+		|| !readVector(in, film.luminanceSquares, numPixels)
+		|| !readVector(in, film.splats, numPixels)
+		|| !readVector(in, film.fixedSplats, numPixels * 3))
+	{
+		std::cout << "ERROR: Checkpoint is truncated or corrupt: " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
\ No newline at end of file
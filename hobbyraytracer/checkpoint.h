@@ -0,0 +1,21 @@
+#pragma once
+
+#include "film.h"
+
+// Everything needed to carry on an interrupted render: the film's accumulation buffers and
+// the seed. Each sample's generator is seeded from (seed, pixel, sample index) and every pixel
+// knows how many samples it has taken, so that is the whole of the RNG state.
+struct checkpoint_desc
+{
+	uint64_t seed;
+	film_state film;
+};
+
+class Checkpoint
+{
+public:
+	// Writes to a temporary file then renames it over path, so a kill part way through never
+	// leaves a corrupt checkpoint behind
+	static bool write(const std::string& path, const checkpoint_desc& checkpoint);
+	static bool read(const std::string& path, checkpoint_desc& checkpoint);
+};
\ No newline at end of file
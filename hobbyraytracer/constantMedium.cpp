@@ -1,7 +1,22 @@
 #include "hobbyraytracer.h"
 #include "constantMedium.h"
 
-bool ConstantMedium::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+#include <bit>
+
+// Uniform float in [0, 1) hashed from the bits of the ray
+static float hashRay(const ray& r)
+{
+    uint64_t h = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        h = hashCombine(h, std::bit_cast<uint32_t>(r.o[i]));
+        h = hashCombine(h, std::bit_cast<uint32_t>(r.dir[i]));
+    }
+
+    return static_cast<float>(h >> 40) * 0x1p-24f;
+}
+
+bool ConstantMedium::scatter(const ray& r, float t_min, float t_max, float& t) const
 {
     hitRecord rec1, rec2;
 
@@ -22,21 +37,39 @@ bool ConstantMedium::hit(const ray& r, float t_min, float t_max, hitRecord& rec)
 
     const float ray_length = glm::length(r.dir);
     const float distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
-    const float hit_distance = negInvDensity * log(glm::linearRand(0.0f, 1.0f));
+    // hit() has no generator to draw from, so derive the free flight distance from the
+    // ray itself - it's unique per bounce and the result is reproducible
+    const float hit_distance = negInvDensity * log(1.0f - hashRay(r));
 
     if (hit_distance > distance_inside_boundary)
         return false;
 
-    rec.t = rec1.t + hit_distance / ray_length;
+    t = rec1.t + hit_distance / ray_length;
+
+    return true;
+}
+
+bool ConstantMedium::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+{
+    if (!scatter(r, t_min, t_max, rec.t))
+        return false;
+
     rec.p = r.at(rec.t);
 
     rec.normal = glm::vec3(1, 0, 0);  // arbitrary
     rec.frontFace = true;     // also arbitrary
     rec.matPtr = phaseFunction;
+    rec.object = this;
 
     return true;
 }
 
+bool ConstantMedium::occluded(const ray& r, float t_min, float t_max) const
+{
+    float t;
+    return scatter(r, t_min, t_max, t);
+}
+
 bool ConstantMedium::boundingBox(AABB& outputBox)
 {
     return boundary->boundingBox(outputBox);
@@ -15,9 +15,13 @@ public:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
 private:
+	// Where along r the ray scatters inside the medium, false if it passes through
+	bool scatter(const ray& r, float t_min, float t_max, float& t) const;
+
 	std::shared_ptr<Hittable> boundary;
 	std::shared_ptr<Material> phaseFunction;
 	float negInvDensity;
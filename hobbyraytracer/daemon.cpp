@@ -0,0 +1,144 @@
+#include "hobbyraytracer.h"
+#include "daemon.h"
+
+#include <sstream>
+
+static std::string jsonString(const std::string& s)
+{
+	std::stringstream out;
+	out << '"';
+
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c == '\n')
+			out << "\\n";
+		else if (static_cast<unsigned char>(c) < 0x20)
+			out << ' ';
+		else
+			out << c;
+	}
+
+	out << '"';
+	return out.str();
+}
+
+bool RenderDaemon::run(const std::string& address, const std::atomic<bool>& stop)
+{
+	Socket server = Socket::listenOn(address);
+	if (!server.valid())
+		return false;
+
+	std::cout << "Daemon waiting for jobs on: " << address << std::endl;
+
+	bool running = true;
+
+	while (running && !stop)
+	{
+		if (!server.waitReadable(100))
+			continue;
+
+		Socket client = server.accept();
+
+		while (running && !stop && client.valid())
+		{
+			if (!client.waitReadable(100))
+				continue;
+
+			std::string line;
+			if (!client.recvLine(line))
+				break;
+
+			if (!line.empty())
+				running = runJob(line, client);
+		}
+	}
+
+	std::cout << "Daemon stopped" << std::endl;
+
+	return true;
+}
+
+bool RenderDaemon::runJob(const std::string& line, Socket& client)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::string id;
+	std::shared_ptr<Film> film;
+	bool sendImage = false;
+
+	std::vector<RenderContext> contexts = replicas;
+
+	try {
+		YAML::Node job = YAML::Load(line);
+
+		if (job["id"])
+			id = job["id"].as<std::string>();
+
+		if (job["command"] && job["command"].as<std::string>() == "shutdown")
+		{
+			client.sendLine("{\"status\":\"ok\",\"id\":" + jsonString(id) + "}");
+			return false;
+		}
+
+		if (job["send_image"])
+			sendImage = job["send_image"].as<bool>();
+
+		film = scene.createFilm(job["film"]);
+
+		Camera camera = scene.createCamera(job["camera"], film->getAspectRatio());
+		for (RenderContext& ctx : contexts)
+		{
+			ctx.camera = camera;
+			ctx.sampler.samples = film->getFilm().samples;
+		}
+	}
+	catch (const YAML::Exception& ex) {
+		std::cout << "Rejected job: " << ex.what() << std::endl;
+		client.sendLine("{\"status\":\"error\",\"id\":" + jsonString(id) + ",\"message\":" + jsonString(ex.what()) + "}");
+		return true;
+	}
+
+	film_desc f = film->getFilm();
+
+	std::cout << "Job " << (id.empty() ? "" : id + " ") << f.dimensions.x << "x" << f.dimensions.y
+		<< ", " << f.samples << " samples" << std::endl;
+
+	render(contexts, film);
+
+	std::vector<uint8_t> image;
+	bool written = true;
+
+	if (sendImage)
+		image = film->encodeFilm();
+	else
+		written = film->outputFilm() != 0;
+
+	float seconds = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+
+	glm::ivec2 range;
+	film->getSampleStatistics(range);
+
+	std::stringstream reply;
+	reply << "{\"status\":" << (written ? "\"ok\"" : "\"error\"")
+		<< ",\"id\":" << jsonString(id)
+		<< ",\"width\":" << f.dimensions.x
+		<< ",\"height\":" << f.dimensions.y
+		<< ",\"samples\":" << range.x
+		<< ",\"seconds\":" << seconds;
+
+	if (sendImage)
+		reply << ",\"bytes\":" << image.size();
+	else if (written)
+		reply << ",\"output\":" << jsonString(film->getOutputName());
+	else
+		reply << ",\"message\":" << jsonString("Could not write " + film->getOutputName());
+
+	reply << "}";
+
+	if (client.sendLine(reply.str()) && sendImage)
+		client.sendAll(image.data(), image.size());
+
+	return true;
+}
\ No newline at end of file
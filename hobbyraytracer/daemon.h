@@ -0,0 +1,34 @@
+#pragma once
+
+#include "scene.h"
+#include "socket.h"
+#include "renderer.h"
+
+// Renders a film with the given contexts, the same way a normal run would
+using RenderFunction = std::function<void(const std::vector<RenderContext>& replicas, std::shared_ptr<Film>& film)>;
+
+// Keeps a loaded scene - meshes, textures and BVHs - in memory and renders jobs sent to a local
+// socket, so changing the camera or sample count doesn't mean loading everything again.
+//
+// A job is one line of JSON (or flow style YAML) using the same keys as the scene file, all optional:
+//   {"id": "a", "film": {"width": 320, "samples": 8, "output": "a.png"}, "camera": {"fov": 30}, "send_image": true}
+// The reply is one line of JSON. With send_image the image isn't written, instead the reply gives
+// its size in "bytes" and the encoded file follows. {"command": "shutdown"} stops the daemon.
+// Clients are served one at a time, in the order they connect.
+class RenderDaemon
+{
+public:
+	RenderDaemon(Scene& scene, std::vector<RenderContext> replicas, RenderFunction render)
+		: scene(scene), replicas(replicas), render(render) { }
+
+	// Serve jobs on address until stop is set or a client asks to shut down
+	bool run(const std::string& address, const std::atomic<bool>& stop);
+
+private:
+	// Returns false once the daemon should stop
+	bool runJob(const std::string& line, Socket& client);
+
+	Scene& scene;
+	std::vector<RenderContext> replicas;
+	RenderFunction render;
+};
\ No newline at end of file
@@ -0,0 +1,408 @@
+#include "hobbyraytracer.h"
+#include "distributed.h"
+
+constexpr uint32_t DISTRIBUTED_MAGIC = 0x44545248; // "HRTD"
+
+constexpr int MAX_ISSUES = 3; // Never have more than this many copies of one unit out
+constexpr double LATE_FACTOR = 4.0; // A unit is late once it's been out this many times the average
+constexpr double MIN_LATE_SECONDS = 1.0;
+
+struct worker_hello
+{
+	uint32_t magic;
+	int32_t threads;
+	glm::ivec2 dimensions;
+};
+
+struct job_header
+{
+	uint32_t magic;
+	uint64_t seed;
+};
+
+Coordinator::Coordinator(std::shared_ptr<Film> film, uint64_t seed) : film(film), seed(seed)
+{
+	film_desc f = film->getFilm();
+
+	// Progressive films are split into sample ranges too, so the whole frame converges together
+	int chunk = f.progressive ? glm::max(f.samplesPerPass, 1) : f.samples;
+
+	std::vector<Tile> tiles = TileScheduler::split(f.dimensions, f.tileSize);
+
+	for (int firstSample = 0; firstSample < f.samples; firstSample += chunk)
+	{
+		for (const Tile& tile : tiles)
+		{
+			unit_state state;
+			state.unit = { (int32_t)units.size(), tile.min, tile.max, firstSample, glm::min(chunk, f.samples - firstSample) };
+
+			pending.push_back(state.unit.id);
+			units.push_back(state);
+		}
+	}
+
+	remaining = (int)units.size();
+}
+
+bool Coordinator::run(const std::string& address, const std::atomic<bool>& stop)
+{
+	Socket server = Socket::listenOn(address);
+	if (!server.valid())
+		return false;
+
+	std::cout << "Coordinating " << units.size() << " work units, waiting for workers on: " << address << std::endl;
+
+	std::vector<std::thread> connections;
+
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			if (remaining == 0 || stop)
+				break;
+		}
+
+		if (!server.waitReadable(100))
+			continue;
+
+		Socket worker = server.accept();
+		if (worker.valid())
+			connections.emplace_back(&Coordinator::serve, this, std::move(worker), (int)connections.size(), std::cref(stop));
+	}
+
+	cv.notify_all();
+
+	for (std::thread& t : connections)
+	{
+		t.join();
+	}
+
+	std::cout << std::endl;
+
+	return remaining == 0;
+}
+
+int Coordinator::nextUnit(const std::vector<int>& inFlight)
+{
+	auto now = std::chrono::high_resolution_clock::now();
+	int next = -1;
+
+	while (next < 0 && !pending.empty())
+	{
+		int id = pending.front();
+		pending.pop_front();
+
+		if (!units[id].done)
+			next = id;
+	}
+
+	// Nothing new left - duplicate whichever unit is the most overdue, so a slow or hung worker
+	// can't hold up the end of the frame
+	if (next < 0)
+	{
+		double average = completedUnits > 0 ? completedSeconds / completedUnits : MIN_LATE_SECONDS;
+		double late = glm::max(LATE_FACTOR * average, MIN_LATE_SECONDS);
+
+		for (int id = 0; id < (int)units.size(); id++)
+		{
+			const unit_state& u = units[id];
+			if (u.done || u.issued >= MAX_ISSUES || std::find(inFlight.begin(), inFlight.end(), id) != inFlight.end())
+				continue;
+
+			double age = std::chrono::duration<double>(now - u.lastIssued).count();
+			if (age > late)
+			{
+				next = id;
+				late = age;
+			}
+		}
+	}
+
+	if (next >= 0)
+	{
+		units[next].issued++;
+		units[next].lastIssued = now;
+	}
+
+	return next;
+}
+
+void Coordinator::serve(Socket worker, int workerId, const std::atomic<bool>& stop)
+{
+	worker_hello hello;
+	if (!worker.recvAll(&hello, sizeof(hello)) || hello.magic != DISTRIBUTED_MAGIC
+		|| hello.dimensions != film->getFilm().dimensions)
+	{
+		std::cout << std::endl << "Rejected worker " << workerId << ", not a worker or rendering a different film size" << std::endl;
+		return;
+	}
+
+	job_header header = { DISTRIBUTED_MAGIC, seed };
+	if (!worker.sendAll(&header, sizeof(header)))
+		return;
+
+	std::cout << std::endl << "Worker " << workerId << " connected, " << hello.threads << " threads" << std::endl;
+
+	// One spare, so a worker has something to start on while its last result is in transit
+	size_t capacity = glm::clamp(hello.threads, 1, 1024) + 1;
+
+	std::vector<int> inFlight;
+	std::vector<glm::vec3> radiance;
+	bool lost = false;
+
+	while (!lost)
+	{
+		std::vector<WorkUnit> issued;
+
+		{
+			std::unique_lock<std::mutex> lock(m);
+
+			while (inFlight.size() < capacity && !stop)
+			{
+				int id = nextUnit(inFlight);
+				if (id < 0)
+					break;
+
+				inFlight.push_back(id);
+				issued.push_back(units[id].unit);
+			}
+
+			if (inFlight.empty())
+			{
+				if (remaining == 0 || stop)
+					break;
+
+				cv.wait_for(lock, std::chrono::milliseconds(100));
+				continue;
+			}
+		}
+
+		for (const WorkUnit& unit : issued)
+		{
+			lost = lost || !worker.sendAll(&unit, sizeof(unit));
+		}
+
+		if (lost)
+			break;
+
+		// Once the frame is complete, stop waiting on any duplicates still out
+		if (!worker.waitReadable(100))
+		{
+			std::lock_guard<std::mutex> lock(m);
+			if (remaining == 0 || stop)
+				break;
+
+			continue;
+		}
+
+		WorkUnit result;
+		if (!worker.recvAll(&result, sizeof(result)))
+		{
+			lost = true;
+			break;
+		}
+
+		auto it = std::find(inFlight.begin(), inFlight.end(), result.id);
+		if (it == inFlight.end())
+		{
+			std::cout << std::endl << "Worker " << workerId << " sent a unit it was never given" << std::endl;
+			lost = true;
+			break;
+		}
+
+		const WorkUnit& unit = units[result.id].unit;
+
+		radiance.resize((size_t)(unit.max.x - unit.min.x) * (unit.max.y - unit.min.y));
+		if (!worker.recvAll(radiance.data(), radiance.size() * sizeof(glm::vec3)))
+		{
+			lost = true;
+			break;
+		}
+
+		inFlight.erase(it);
+
+		bool first = false;
+		int left = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(m);
+
+			unit_state& u = units[result.id];
+			if (!u.done)
+			{
+				first = true;
+				u.done = true;
+				left = --remaining;
+
+				completedSeconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - u.lastIssued).count();
+				completedUnits++;
+			}
+		}
+
+		if (first)
+		{
+			merge(unit, radiance);
+			std::cout << "\rWork units remaining: " << left << "   " << std::flush;
+		}
+
+		cv.notify_all();
+	}
+
+	if (lost)
+	{
+		int requeued = 0;
+
+		{
+			std::lock_guard<std::mutex> lock(m);
+
+			for (int id : inFlight)
+			{
+				if (!units[id].done)
+				{
+					pending.push_front(id);
+					requeued++;
+				}
+			}
+		}
+
+		cv.notify_all();
+
+		std::cout << std::endl << "Lost worker " << workerId << ", re-issuing " << requeued << " work units" << std::endl;
+		return;
+	}
+
+	WorkUnit done = { -1 };
+	worker.sendAll(&done, sizeof(done));
+}
+
+void Coordinator::merge(const WorkUnit& unit, const std::vector<glm::vec3>& radiance)
+{
+	FilmTile filmTile = film->getFilmTile({ unit.min, unit.max, unit.id });
+
+	int i = 0;
+	for (int y = unit.min.y; y < unit.max.y; y++)
+	{
+		for (int x = unit.min.x; x < unit.max.x; x++)
+		{
+			filmTile.addSamples({ x, y }, radiance[i++], unit.sampleCount);
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(filmMutex);
+	film->mergeFilmTile(filmTile);
+}
+
+bool RenderWorker::run(const std::string& address)
+{
+	// Give a coordinator started at the same time a few seconds to come up
+	Socket coordinator;
+	for (int attempt = 0; attempt < 50 && !coordinator.valid(); attempt++)
+	{
+		coordinator = Socket::connectTo(address);
+
+		if (!coordinator.valid())
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	if (!coordinator.valid())
+	{
+		std::cout << "ERROR: Could not reach coordinator: " << address << std::endl;
+		return false;
+	}
+
+	worker_hello hello = { DISTRIBUTED_MAGIC, numThreads, dimensions };
+	job_header header;
+
+	if (!coordinator.sendAll(&hello, sizeof(hello)) || !coordinator.recvAll(&header, sizeof(header))
+		|| header.magic != DISTRIBUTED_MAGIC)
+	{
+		std::cout << "ERROR: Coordinator refused this worker: " << address << std::endl;
+		return false;
+	}
+
+	std::cout << "Connected to coordinator: " << address << ", rendering on " << numThreads << " threads" << std::endl;
+
+	std::deque<WorkUnit> queue;
+	bool finished = false;
+	std::mutex m;
+	std::condition_variable cv;
+
+	std::mutex sendMutex;
+	std::atomic<int> rendered = 0;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < numThreads; t++)
+	{
+		threads.emplace_back([&]() {
+			RayStats stats;
+			std::unique_ptr<Sampler> sampler = Sampler::create(ctx.sampler, dimensions, header.seed);
+
+			while (true)
+			{
+				WorkUnit unit;
+
+				{
+					std::unique_lock<std::mutex> lock(m);
+					cv.wait(lock, [&]() { return finished || !queue.empty(); });
+
+					if (queue.empty())
+						return;
+
+					unit = queue.front();
+					queue.pop_front();
+				}
+
+				FilmTile filmTile({ unit.min, unit.max, unit.id });
+
+				for (int y = unit.min.y; y < unit.max.y; y++)
+				{
+					for (int x = unit.min.x; x < unit.max.x; x++)
+					{
+						renderPixel(ctx, dimensions, *sampler, { x, y }, unit.firstSample, unit.sampleCount, filmTile, stats);
+					}
+				}
+
+				const std::vector<glm::vec3>& radiance = filmTile.getRadiance();
+
+				std::lock_guard<std::mutex> lock(sendMutex);
+
+				if (!coordinator.sendAll(&unit, sizeof(unit))
+					|| !coordinator.sendAll(radiance.data(), radiance.size() * sizeof(glm::vec3)))
+				{
+					std::lock_guard<std::mutex> guard(m);
+					finished = true;
+					cv.notify_all();
+					return;
+				}
+
+				rendered++;
+			}
+		});
+	}
+
+	// This thread just takes work off the wire
+	WorkUnit unit;
+	while (coordinator.recvAll(&unit, sizeof(unit)) && unit.id >= 0)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		queue.push_back(unit);
+		cv.notify_one();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m);
+		finished = true;
+		queue.clear();
+	}
+
+	cv.notify_all();
+
+	for (std::thread& t : threads)
+	{
+		t.join();
+	}
+
+	std::cout << "Rendered " << rendered << " work units" << std::endl;
+
+	return true;
+}
\ No newline at end of file
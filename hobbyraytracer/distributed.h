@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+
+#include "socket.h"
+#include "renderer.h"
+
+// Messages go over the wire as raw structs, so the coordinator and its workers need the same byte order
+
+// Some samples of every pixel in one tile, id -1 tells a worker to shut down
+struct WorkUnit
+{
+	int32_t id;
+	glm::ivec2 min;
+	glm::ivec2 max;
+	int32_t firstSample;
+	int32_t sampleCount;
+};
+
+// Splits a frame into work units and hands them to worker processes as they connect, merging
+// the float results into the film. Each worker is kept a little ahead of its thread count. A
+// worker that disconnects has its outstanding units put back in the queue, and once the queue
+// runs dry, units that have been out far longer than usual are issued again to idle workers -
+// whichever copy comes back first is kept.
+class Coordinator
+{
+public:
+	Coordinator(std::shared_ptr<Film> film, uint64_t seed);
+
+	// Listen on address ("host:port" or a Unix socket path) and render the frame, returns false
+	// if it could not listen or stop was set before every unit came back
+	bool run(const std::string& address, const std::atomic<bool>& stop);
+
+private:
+	struct unit_state
+	{
+		WorkUnit unit;
+		bool done = false;
+		int issued = 0;
+		std::chrono::high_resolution_clock::time_point lastIssued;
+	};
+
+	void serve(Socket worker, int workerId, const std::atomic<bool>& stop);
+
+	// The next unit for a worker already holding inFlight, -1 if there's nothing worth doing.
+	// Call with m held.
+	int nextUnit(const std::vector<int>& inFlight);
+
+	void merge(const WorkUnit& unit, const std::vector<glm::vec3>& radiance);
+
+	std::shared_ptr<Film> film;
+	uint64_t seed;
+
+	std::vector<unit_state> units;
+	std::deque<int> pending;
+	int remaining;
+
+	// Used to judge when an outstanding unit is late
+	double completedSeconds = 0.0;
+	int completedUnits = 0;
+
+	std::mutex m;
+	std::condition_variable cv;
+
+	std::mutex filmMutex; // Two sample ranges of the same tile may arrive together
+};
+
+// Connects to a coordinator and renders whatever work units it sends, on numThreads threads
+class RenderWorker
+{
+public:
+	RenderWorker(const RenderContext& ctx, glm::ivec2 dimensions, int numThreads)
+		: ctx(ctx), dimensions(dimensions), numThreads(numThreads) { }
+
+	// Returns once the coordinator says the frame is done or goes away
+	bool run(const std::string& address);
+
+private:
+	RenderContext ctx;
+	glm::ivec2 dimensions;
+	int numThreads;
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "hobbyraytracer.h"
+#include "distribution.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+// Fills cdf[0..n] from n weights and returns their sum. An all zero row becomes uniform, which
+// never matters for sampling since the marginal never picks it.
+static double buildCdf(const float* weights, int n, float* cdf)
+{
+	double sum = 0.0;
+	cdf[0] = 0.0f;
+
+	for (int i = 0; i < n; i++)
+	{
+		sum += glm::max(weights[i], 0.0f);
+		cdf[i + 1] = (float)sum;
+	}
+
+	for (int i = 1; i <= n; i++)
+		cdf[i] = sum > 0.0 ? (float)(cdf[i] / sum) : (float)i / n;
+
+	cdf[n] = 1.0f;
+
+	return sum;
+}
+
+// Index of the segment of cdf[0..n] that contains x, and how far along it x is
+static int sampleCdf(const float* cdf, int n, float x, float& offset)
+{
+	int i = (int)(std::upper_bound(cdf, cdf + n + 1, x) - cdf) - 1;
+	i = glm::clamp(i, 0, n - 1);
+
+	float width = cdf[i + 1] - cdf[i];
+	offset = width > 0.0f ? glm::clamp((x - cdf[i]) / width, 0.0f, 0.99999994f) : 0.0f;
+
+	return i;
+}
+
+Distribution2D::Distribution2D(const std::vector<float>& weights, int w, int h)
+	: width(w), height(h), conditionalCdf((size_t)w * h + h), marginalCdf(h + 1), rowSums(h)
+{
+	if (width <= 0 || height <= 0)
+		return;
+
+	std::vector<int> rows(height);
+	std::iota(rows.begin(), rows.end(), 0);
+
+	// Rows don't depend on each other, and each is built the same way on any thread
+	std::for_each(std::execution::par, rows.begin(), rows.end(), [&](int j) {
+		rowSums[j] = buildCdf(&weights[(size_t)j * width], width, &conditionalCdf[(size_t)j * (width + 1)]);
+	});
+
+	std::vector<float> rowWeights(rowSums.begin(), rowSums.end());
+	total = buildCdf(rowWeights.data(), height, marginalCdf.data());
+}
+
+glm::vec2 Distribution2D::sample(Sampler& sampler, float& pdf) const
+{
+	float dv, du;
+	int j = sampleCdf(marginalCdf.data(), height, sampler.nextFloat(), dv);
+
+	const float* row = &conditionalCdf[(size_t)j * (width + 1)];
+	int i = sampleCdf(row, width, sampler.nextFloat(), du);
+
+	// Cell weight over the mean weight
+	pdf = (float)((row[i + 1] - row[i]) * rowSums[j] * width * height / total);
+
+	return glm::vec2((i + du) / width, (j + dv) / height);
+}
+
+float Distribution2D::pdf(const glm::vec2& uv) const
+{
+	if (!valid())
+		return 0.0f;
+
+	int i = glm::clamp((int)(uv.x * width), 0, width - 1);
+	int j = glm::clamp((int)(uv.y * height), 0, height - 1);
+
+	const float* row = &conditionalCdf[(size_t)j * (width + 1)];
+
+	return (float)((row[i + 1] - row[i]) * rowSums[j] * width * height / total);
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "sampler.h"
+
+// Piecewise constant distribution over [0, 1)^2 with one cell per entry of a width x height grid
+// of weights. A sample picks a row from the marginal distribution, then a column from that
+// row's conditional one, and lands uniformly inside the cell.
+class Distribution2D
+{
+public:
+	Distribution2D() { }
+
+	// weights is row major. Each row's CDF is built on its own, in parallel.
+	Distribution2D(const std::vector<float>& weights, int width, int height);
+
+	bool valid() const { return total > 0.0; }
+
+	// Density is with respect to area in [0, 1)^2
+	glm::vec2 sample(Sampler& sampler, float& pdf) const;
+	float pdf(const glm::vec2& uv) const;
+
+	// Sum of the weights
+	double sum() const { return total; }
+
+private:
+	int width = 0, height = 0;
+
+	std::vector<float> conditionalCdf; // width + 1 entries per row, normalised
+	std::vector<float> marginalCdf; // height + 1 entries, normalised
+	std::vector<double> rowSums;
+
+	double total = 0.0;
+};
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "hobbyraytracer.h"
+#include "fileWatcher.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// Editors often save in several steps, let them finish before reading the file
+constexpr auto SETTLE_TIME = std::chrono::milliseconds(100);
+
+static std::filesystem::file_time_type modificationTime(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	auto time = std::filesystem::last_write_time(path, ec);
+
+	return ec ? std::filesystem::file_time_type::min() : time;
+}
+
+FileWatcher::FileWatcher(std::filesystem::path path)
+{
+#ifdef __linux__
+	inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+	watch(path);
+}
+
+void FileWatcher::watch(std::filesystem::path p)
+{
+	watchedFile file;
+	file.path = std::filesystem::absolute(p);
+	file.lastWrite = modificationTime(file.path);
+
+	for (const watchedFile& watched : files)
+	{
+		if (watched.path == file.path)
+			return;
+	}
+
+#ifdef __linux__
+	// Files in the same directory share its watch
+	if (inotify >= 0)
+		file.directory = inotify_add_watch(inotify, file.path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+	if (file.directory < 0)
+		std::cout << "Could not watch " << file.path.string() << " with inotify, polling instead" << std::endl;
+#endif
+
+	files.push_back(file);
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (inotify >= 0)
+		::close(inotify);
+#endif
+}
+
+bool FileWatcher::wait(const std::atomic<bool>& stop)
+{
+	while (!stop)
+	{
+		bool changed = false;
+
+#ifdef __linux__
+		bool watching = false;
+		for (const watchedFile& file : files)
+		{
+			if (file.directory >= 0)
+				watching = true;
+		}
+
+		if (watching)
+		{
+			pollfd fd = { inotify, POLLIN, 0 };
+
+			if (poll(&fd, 1, 100) > 0)
+			{
+				alignas(inotify_event) char buffer[4096];
+				ssize_t length;
+
+				while ((length = read(inotify, buffer, sizeof(buffer))) > 0)
+				{
+					for (char* p = buffer; p < buffer + length; )
+					{
+						const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+
+						for (const watchedFile& file : files)
+						{
+							if (event->len > 0 && event->wd == file.directory && file.path.filename() == event->name)
+								changed = true;
+						}
+
+						p += sizeof(inotify_event) + event->len;
+					}
+				}
+			}
+		}
+		else
+#endif
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+		}
+
+		// Anything inotify couldn't watch
+		for (const watchedFile& file : files)
+		{
+			if (file.directory < 0 && modificationTime(file.path) != file.lastWrite)
+				changed = true;
+		}
+
+		if (changed)
+		{
+			std::this_thread::sleep_for(SETTLE_TIME);
+
+			// Drop whatever else arrived while settling, it's all the same change
+#ifdef __linux__
+			if (inotify >= 0)
+			{
+				char buffer[4096];
+				while (read(inotify, buffer, sizeof(buffer)) > 0) { }
+			}
+#endif
+
+			for (watchedFile& file : files)
+				file.lastWrite = modificationTime(file.path);
+
+			return true;
+		}
+	}
+
+	return false;
+}
\ No newline at end of file
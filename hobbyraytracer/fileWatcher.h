@@ -0,0 +1,33 @@
+#pragma once
+
+// Waits for a file, or any of the others added to it, to change on disk. Uses inotify on Linux,
+// watching the directories so that editors which save by writing a new file and renaming it over
+// the old one are noticed too. Elsewhere it polls the modification times.
+class FileWatcher
+{
+public:
+	FileWatcher(std::filesystem::path path);
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Also wait for path to change, e.g. a mesh the scene file refers to. Watching one twice is harmless.
+	void watch(std::filesystem::path path);
+
+	// Blocks until any of the files changes, returns false if stop was set first
+	bool wait(const std::atomic<bool>& stop);
+
+private:
+	struct watchedFile
+	{
+		std::filesystem::path path;
+		std::filesystem::file_time_type lastWrite;
+
+		int directory = -1; // inotify watch on its directory, polled without one
+	};
+
+	std::vector<watchedFile> files;
+
+	int inotify = -1;
+};
\ No newline at end of file
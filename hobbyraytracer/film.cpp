@@ -15,11 +15,242 @@
 #pragma warning (pop)
 #endif
 
-Film::Film(int w, int h, int samples, std::string output)
+// 20 fractional bits, leaving headroom for ~10^12 of accumulated radiance per pixel
+constexpr double SPLAT_FIXED_POINT_SCALE = 1 << 20;
+
+// Largest fixed point splat, well inside int64 so thousands of them still can't overflow a pixel
+constexpr double SPLAT_FIXED_POINT_MAX = 0x1p52;
+
+// Luminance below which a pixel's error is measured in absolute rather than relative terms
+constexpr float ADAPTIVE_MIN_LUMINANCE = 0.01f;
+
+Film::Film(const film_desc& desc, std::string output)
 {
 	outputName = output;
-	f = { glm::ivec2(w, h), samples };
-	pixels.resize(w * h * 3);
+	f = desc;
+
+	int numPixels = f.dimensions.x * f.dimensions.y;
+
+	pixels.resize(numPixels * 3);
+	radiance.resize(numPixels, glm::vec3(0.0f));
+	sampleCounts.resize(numPixels, 0);
+	luminanceSquares.resize(numPixels, 0.0f);
+	splats.resize(numPixels, glm::vec3(0.0f));
+	fixedSplats.resize(numPixels * 3, 0);
+}
+
+void Film::mergeFilmTile(const FilmTile& tile)
+{
+	const Tile& t = tile.getTile();
+
+	for (int y = t.min.y; y < t.max.y; y++)
+	{
+		for (int x = t.min.x; x < t.max.x; x++)
+		{
+			int src = tile.index({ x, y });
+			int dst = y * f.dimensions.x + x;
+
+			radiance[dst] += tile.radiance[src];
+			sampleCounts[dst] += tile.samples[src];
+			luminanceSquares[dst] += tile.squares[src];
+		}
+	}
+}
+
+void Film::addSplat(glm::vec2 pixel, const glm::vec3& L)
+{
+	int x = static_cast<int>(pixel.x);
+	int y = static_cast<int>(pixel.y);
+
+	if (x < 0 || y < 0 || x >= f.dimensions.x || y >= f.dimensions.y)
+		return;
+
+	// One bad sample would otherwise spoil the pixel for good
+	if (!std::isfinite(L.x) || !std::isfinite(L.y) || !std::isfinite(L.z))
+		return;
+
+	int i = y * f.dimensions.x + x;
+
+	// Float addition isn't associative, integer addition is
+	if (deterministic)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			double scaled = glm::clamp(L[c] * SPLAT_FIXED_POINT_SCALE, -SPLAT_FIXED_POINT_MAX, SPLAT_FIXED_POINT_MAX);
+			int64_t fixed = static_cast<int64_t>(std::llround(scaled));
+			std::atomic_ref<int64_t>(fixedSplats[i * 3 + c]).fetch_add(fixed, std::memory_order_relaxed);
+		}
+
+		return;
+	}
+
+	for (int c = 0; c < 3; c++)
+	{
+		std::atomic_ref<float>(splats[i][c]).fetch_add(L[c], std::memory_order_relaxed);
+	}
+}
+
+void Film::firstTouch(TileScheduler& scheduler)
+{
+	int numPixels = f.dimensions.x * f.dimensions.y;
+
+	filmBuffer<glm::vec3> newRadiance(numPixels);
+	filmBuffer<int> newSampleCounts(numPixels);
+	filmBuffer<float> newLuminanceSquares(numPixels);
+	filmBuffer<glm::vec3> newSplats(numPixels);
+	filmBuffer<int64_t> newFixedSplats(numPixels * 3);
+
+	scheduler.run([&](int worker, const Tile& tile) {
+		for (int y = tile.min.y; y < tile.max.y; y++)
+		{
+			int begin = y * f.dimensions.x + tile.min.x;
+			int end = y * f.dimensions.x + tile.max.x;
+
+			std::copy(radiance.begin() + begin, radiance.begin() + end, newRadiance.begin() + begin);
+			std::copy(sampleCounts.begin() + begin, sampleCounts.begin() + end, newSampleCounts.begin() + begin);
+			std::copy(luminanceSquares.begin() + begin, luminanceSquares.begin() + end, newLuminanceSquares.begin() + begin);
+			std::copy(splats.begin() + begin, splats.begin() + end, newSplats.begin() + begin);
+			std::copy(fixedSplats.begin() + begin * 3, fixedSplats.begin() + end * 3, newFixedSplats.begin() + begin * 3);
+		}
+	});
+
+	radiance = std::move(newRadiance);
+	sampleCounts = std::move(newSampleCounts);
+	luminanceSquares = std::move(newLuminanceSquares);
+	splats = std::move(newSplats);
+	fixedSplats = std::move(newFixedSplats);
+}
+
+film_state Film::getState() const
+{
+	return {
+		f.dimensions,
+		{ radiance.begin(), radiance.end() },
+		{ sampleCounts.begin(), sampleCounts.end() },
+		{ luminanceSquares.begin(), luminanceSquares.end() },
+		{ splats.begin(), splats.end() },
+		{ fixedSplats.begin(), fixedSplats.end() }
+	};
+}
+
+bool Film::setState(film_state state)
+{
+	if (state.dimensions != f.dimensions)
+	{
+		std::cout << "ERROR: Film is " << f.dimensions.x << "x" << f.dimensions.y << " but the saved state is "
+			<< state.dimensions.x << "x" << state.dimensions.y << std::endl;
+		return false;
+	}
+
+	radiance.assign(state.radiance.begin(), state.radiance.end());
+	sampleCounts.assign(state.sampleCounts.begin(), state.sampleCounts.end());
+	luminanceSquares.assign(state.luminanceSquares.begin(), state.luminanceSquares.end());
+	splats.assign(state.splats.begin(), state.splats.end());
+	fixedSplats.assign(state.fixedSplats.begin(), state.fixedSplats.end());
+
+	return true;
+}
+
+float Film::getRelativeError(glm::ivec2 pixel) const
+{
+	int i = pixel.y * f.dimensions.x + pixel.x;
+	int n = sampleCounts[i];
+
+	if (n < 2)
+		return std::numeric_limits<float>::infinity();
+
+	float mean = luminance(radiance[i]) / n;
+	float variance = glm::max(luminanceSquares[i] / n - mean * mean, 0.0f) * n / (n - 1);
+
+	return std::sqrt(variance / n) / glm::max(mean, ADAPTIVE_MIN_LUMINANCE);
+}
+
+bool Film::isConverged(glm::ivec2 pixel) const
+{
+	return f.adaptive
+		&& getSampleCount(pixel) >= f.minSamples
+		&& getRelativeError(pixel) < f.adaptiveThreshold;
+}
+
+int Film::getActivePixels() const
+{
+	int active = 0;
+
+	for (int y = 0; y < f.dimensions.y; y++)
+	{
+		for (int x = 0; x < f.dimensions.x; x++)
+		{
+			if (getSampleCount({ x, y }) < f.samples && !isConverged({ x, y }))
+				active++;
+		}
+	}
+
+	return active;
+}
+
+float Film::getSampleStatistics(glm::ivec2& range) const
+{
+	if (sampleCounts.empty())
+	{
+		range = glm::ivec2(0);
+		return 0.0f;
+	}
+
+	auto [min, max] = std::minmax_element(sampleCounts.begin(), sampleCounts.end());
+	range = glm::ivec2(*min, *max);
+
+	long long total = 0;
+	for (int count : sampleCounts)
+	{
+		total += count;
+	}
+
+	return (float)total / (float)sampleCounts.size();
+}
+
+void Film::develop()
+{
+	int numPixels = f.dimensions.x * f.dimensions.y;
+
+	// Every camera sample may have splatted somewhere in the image, so splats are
+	// normalised by the average number of samples taken per pixel
+	long long totalSamples = 0;
+	for (int count : sampleCounts)
+	{
+		totalSamples += count;
+	}
+
+	float splatScale = totalSamples > 0 ? (float)numPixels / (float)totalSamples : 0.0f;
+
+	bool hdr = ends_with(outputName, ".hdr");
+	hdrPixels.resize(hdr ? numPixels * 3 : 0);
+
+	for (int i = 0; i < numPixels; i++)
+	{
+		glm::vec3 splat = splats[i] + glm::vec3(
+			fixedSplats[i * 3] / SPLAT_FIXED_POINT_SCALE,
+			fixedSplats[i * 3 + 1] / SPLAT_FIXED_POINT_SCALE,
+			fixedSplats[i * 3 + 2] / SPLAT_FIXED_POINT_SCALE
+		);
+
+		glm::vec3 colour = splat * splatScale;
+
+		if (sampleCounts[i] > 0)
+		{
+			colour += radiance[i] / static_cast<float>(sampleCounts[i]);
+		}
+
+		if (hdr)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				hdrPixels[i * 3 + c] = colour[c] == colour[c] ? colour[c] : 0.0f;
+			}
+		}
+
+		tonemap(colour);
+		writeColour(colour, pixels.begin() + (i * 3));
+	}
 }
 
 void Film::writeColour(glm::vec3 colour, std::vector<uint8_t>::iterator p)
@@ -58,22 +289,67 @@ film_desc Film::getFilm() const
 
 int Film::outputFilm()
 {
-	if (ends_with(outputName, ".png"))
+	develop();
+
+	return writeImage(outputName, f.dimensions, pixels, hdrPixels);
+}
+
+std::future<int> Film::outputFilmAsync()
+{
+	develop();
+
+	// The worker gets its own copy, so rendering can carry on into the buffers straight away
+	return std::async(std::launch::async, &Film::writeImage, outputName, f.dimensions, pixels, hdrPixels);
+}
+
+std::vector<uint8_t> Film::encodeFilm()
+{
+	develop();
+
+	std::vector<uint8_t> encoded;
+
+	auto append = [](void* context, void* data, int size) {
+		auto* out = static_cast<std::vector<uint8_t>*>(context);
+		out->insert(out->end(), static_cast<uint8_t*>(data), static_cast<uint8_t*>(data) + size);
+	};
+
+	glm::ivec2 d = f.dimensions;
+
+	if (ends_with(outputName, ".hdr"))
+		stbi_write_hdr_to_func(append, &encoded, d.x, d.y, 3, hdrPixels.data());
+	else if (ends_with(outputName, ".png"))
+		stbi_write_png_to_func(append, &encoded, d.x, d.y, 3, pixels.data(), d.x * 3);
+	else if (ends_with(outputName, ".tga"))
+		stbi_write_tga_to_func(append, &encoded, d.x, d.y, 3, pixels.data());
+	else
+		stbi_write_bmp_to_func(append, &encoded, d.x, d.y, 3, pixels.data());
+
+	return encoded;
+}
+
+int Film::writeImage(std::string name, glm::ivec2 dimensions, std::vector<uint8_t> pixels, std::vector<float> hdrPixels)
+{
+	if (ends_with(name, ".hdr"))
+	{
+		return stbi_write_hdr(name.c_str(), dimensions.x, dimensions.y, 3, hdrPixels.data());
+	}
+
+	if (ends_with(name, ".png"))
 	{
-		return stbi_write_png(outputName.c_str(), f.dimensions.x, f.dimensions.y, 3, pixels.data(), f.dimensions.x * 3);
+		return stbi_write_png(name.c_str(), dimensions.x, dimensions.y, 3, pixels.data(), dimensions.x * 3);
 	}
 
-	if (ends_with(outputName, ".tga"))
+	if (ends_with(name, ".tga"))
 	{
-		return stbi_write_tga(outputName.c_str(), f.dimensions.x, f.dimensions.y, 3, pixels.data());
+		return stbi_write_tga(name.c_str(), dimensions.x, dimensions.y, 3, pixels.data());
 	}
 
-	if (!ends_with(outputName, ".bmp"))
+	if (!ends_with(name, ".bmp"))
 	{
 		std::cout << "File type not supported, generating bitmap!" << std::endl;
 	}
 
-	std::cout << ">>> " << outputName << std::endl;
+	std::cout << ">>> " << name << std::endl;
 
-	return stbi_write_bmp(outputName.c_str(), f.dimensions.x, f.dimensions.y, 3, pixels.data());
-}
+	return stbi_write_bmp(name.c_str(), dimensions.x, dimensions.y, 3, pixels.data());
+}
\ No newline at end of file
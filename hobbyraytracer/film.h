@@ -1,33 +1,190 @@
 #pragma once
 
+#include "scheduler.h"
+
 struct film_desc
 {
 	glm::ivec2 dimensions;
 	int samples;
+
+	int tileSize = 32; // Edge length of a render tile in pixels
+	int threads = 0; // Number of render threads, 0 = one per hardware thread
+
+	float timeLimit = 0.0f; // Wall clock budget in seconds, 0 = render all samples
+	int samplesPerPass = 1; // Samples per pixel in each progressive pass
+
+	bool progressive = false; // Render in passes over the whole image, rewriting the output as it goes
+	int flushPasses = 0; // Rewrite the output every N passes, 0 = never
+	float flushSeconds = 0.0f; // Rewrite the output at the first pass boundary T seconds after the last, 0 = never
+
+	bool adaptive = false; // Stop sampling a pixel once its relative error drops below adaptiveThreshold
+	float adaptiveThreshold = 0.02f; // Standard error of a pixel's luminance over its mean
+	int minSamples = 16; // Samples every pixel gets before its error estimate is trusted
+};
+
+// Default initialises rather than value initialises the elements of a new vector, which for
+// plain types means not writing them at all, so none of its pages are touched until they're
+// filled in
+template <typename T>
+struct uninitialisedAllocator : std::allocator<T>
+{
+	template <typename U>
+	struct rebind { using other = uninitialisedAllocator<U>; };
+
+	template <typename U, typename... Args>
+	void construct(U* p, Args&&... args) { ::new ((void*)p) U(std::forward<Args>(args)...); }
+
+	template <typename U>
+	void construct(U* p) { ::new ((void*)p) U; }
+};
+
+template <typename T>
+using filmBuffer = std::vector<T, uninitialisedAllocator<T>>;
+
+// The film's raw accumulation buffers, enough to carry on rendering into it later
+struct film_state
+{
+	glm::ivec2 dimensions;
+	std::vector<glm::vec3> radiance;
+	std::vector<int> sampleCounts;
+	std::vector<float> luminanceSquares;
+	std::vector<glm::vec3> splats;
+	std::vector<int64_t> fixedSplats;
+};
+
+// A worker's private accumulation buffer for one tile of the film. Tiles never overlap,
+// so merging one back into the film needs no locking.
+class FilmTile
+{
+public:
+	FilmTile(const Tile& t)
+		: tile(t),
+		radiance(t.area(), glm::vec3(0.0f)),
+		samples(t.area(), 0),
+		squares(t.area(), 0.0f) { }
+
+	void addSample(glm::ivec2 pixel, const glm::vec3& L)
+	{
+		int i = index(pixel);
+		radiance[i] += L;
+		samples[i]++;
+
+		float y = luminance(L);
+		squares[i] += y * y;
+	}
+
+	// Add the sum of count samples at once, e.g. ones rendered elsewhere. Without the sum of
+	// their squared luminances the pixel's error estimate is meaningless, see Film::getRelativeError.
+	void addSamples(glm::ivec2 pixel, const glm::vec3& sum, int count, float sumSquares = 0.0f)
+	{
+		int i = index(pixel);
+		radiance[i] += sum;
+		samples[i] += count;
+		squares[i] += sumSquares;
+	}
+
+	const Tile& getTile() const { return tile; }
+
+	// Summed radiance per pixel, row by row across the tile
+	const std::vector<glm::vec3>& getRadiance() const { return radiance; }
+
+private:
+	int index(glm::ivec2 pixel) const
+	{
+		return (pixel.y - tile.min.y) * (tile.max.x - tile.min.x) + (pixel.x - tile.min.x);
+	}
+
+	friend class Film;
+
+	Tile tile;
+
+	std::vector<glm::vec3> radiance;
+	std::vector<int> samples;
+	std::vector<float> squares; // Sum of squared luminance per pixel
 };
 
 // Standard film with aces tonemapping and Gamma correction
 class Film
 {
 public:
-	Film(int w, int h, int samples, std::string output);
+	Film(const film_desc& desc, std::string output);
 
 	// Inherited via Film
 	const glm::vec3& tonemap(glm::vec3& colour);
 	static void writeColour(glm::vec3 colour, std::vector<uint8_t>::iterator p);
 
 	film_desc getFilm() const;
+	const std::string& getOutputName() const { return outputName; }
 	float getAspectRatio() const {
 		return (float)f.dimensions.x / (float)f.dimensions.y;
 	}
-	
+
 	const std::vector<uint8_t>::iterator getPixels() { return pixels.begin(); }
 
+	FilmTile getFilmTile(const Tile& tile) const { return FilmTile(tile); }
+
+	// Add a finished tile's samples to the film, safe to call concurrently for different tiles
+	void mergeFilmTile(const FilmTile& tile);
+
+	// Add a contribution to an arbitrary pixel (e.g. from light tracing), lock free
+	void addSplat(glm::vec2 pixel, const glm::vec3& L);
+
+	// Accumulate splats in fixed point so the result doesn't depend on the order they land in
+	void setDeterministic(bool d) { deterministic = d; }
+
+	// Samples taken so far in one pixel
+	int getSampleCount(glm::ivec2 pixel) const { return sampleCounts[pixel.y * f.dimensions.x + pixel.x]; }
+
+	// Standard error of the pixel's mean luminance relative to the mean, from the samples so far.
+	// Dark pixels are measured against a small floor rather than their mean, so noise in black
+	// areas that tonemaps to nothing doesn't keep them sampling forever.
+	float getRelativeError(glm::ivec2 pixel) const;
+
+	// Whether an adaptive film has stopped sampling this pixel early
+	bool isConverged(glm::ivec2 pixel) const;
+
+	// Pixels still short of their samples and, in adaptive mode, not yet converged
+	int getActivePixels() const;
+
+	// Move the accumulation buffers into fresh memory, each tile's rows copied across by the
+	// worker the scheduler deals that tile to, so with pinned workers first touch puts them on
+	// that worker's NUMA node (pages straddling tiles go to whichever worker gets there first).
+	// Like the state calls below, not safe while tiles are being merged.
+	void firstTouch(TileScheduler& scheduler);
+
+	// Copy the accumulation buffers out, or replace them, e.g. for checkpointing. Neither is safe
+	// while tiles are being merged, call them between passes.
+	film_state getState() const;
+	bool setState(film_state state);
+
+	// Returns the mean number of samples per pixel, and the (min, max) in range
+	float getSampleStatistics(glm::ivec2& range) const;
+
+	// Resolve the HDR buffers into tonemapped 8 bit pixels (and linear floats for .hdr output)
+	void develop();
+
 	int outputFilm();
 
+	// Develop now, then encode and write the image on another thread
+	std::future<int> outputFilmAsync();
+
+	// Develop and encode the image in memory, in the format the output name asks for
+	std::vector<uint8_t> encodeFilm();
+
 private:
+	static int writeImage(std::string name, glm::ivec2 dimensions, std::vector<uint8_t> pixels, std::vector<float> hdrPixels);
+
 	std::vector<uint8_t> pixels;
+	std::vector<float> hdrPixels; // Linear radiance, only filled in for .hdr output
 	film_desc f;
 
+	filmBuffer<glm::vec3> radiance; // Sum of all samples taken in each pixel
+	filmBuffer<int> sampleCounts;
+	filmBuffer<float> luminanceSquares;
+	filmBuffer<glm::vec3> splats; // Only ever touched through std::atomic_ref
+	filmBuffer<int64_t> fixedSplats; // As above, 3 per pixel, used in deterministic mode
+
+	bool deterministic = false;
+
 	std::string outputName;
 };
\ No newline at end of file
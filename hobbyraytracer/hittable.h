@@ -2,8 +2,10 @@
 
 #include "ray.h"
 #include "aabb.h"
+#include "sampler.h"
 
 class Material;
+class Hittable;
 
 struct hitRecord 
 {
@@ -12,6 +14,9 @@ struct hitRecord
 
 	std::shared_ptr<Material> matPtr;
 
+	// The primitive that was hit, under any transforms, see Hittable::primitive()
+	const Hittable* object = nullptr;
+
 	float t;
 
 	float u, v;
@@ -24,9 +29,41 @@ struct hitRecord
 	}
 };
 
+// A point picked on a surface, for sampling it as a light
+struct surfaceSample
+{
+	glm::vec3 p;
+	glm::vec3 normal;
+
+	float u, v;
+};
+
 class Hittable
 {
 public:
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const = 0;
+
+	// Whether anything lies along r between t_min and t_max, for shadow rays. Stops at the first
+	// surface found rather than the closest, and works out nothing about it.
+	virtual bool occluded(const ray& r, float t_min, float t_max) const = 0;
+
 	virtual bool boundingBox(AABB& outputBox) = 0;
+
+	// Surface area, 0 for anything that can't be sampled as a light
+	virtual float area() const { return 0.0f; }
+
+	// A point picked uniformly by area, only called when area() > 0
+	virtual surfaceSample sampleSurface(Sampler& sampler) const { return {}; }
+
+	// Smaller surfaces that together make up this one, so a light BVH can bound an emitter
+	// piece by piece, e.g. a mesh's triangles. Empty when it doesn't split any further.
+	virtual std::vector<std::shared_ptr<Hittable>> split() const { return {}; }
+
+	// A cone around axis (either way along it) holding every surface normal, false if the
+	// surface faces all ways
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const { return false; }
+
+	// What hit() reports as hitRecord::object, the object itself unless it only transforms
+	// another one
+	virtual const Hittable* primitive() const { return this; }
 };
\ No newline at end of file
@@ -20,6 +20,17 @@ bool HittableList::hit(const ray& r, float t_min, float t_max, hitRecord& rec) c
 	return hitAnything;
 }
 
+bool HittableList::occluded(const ray& r, float t_min, float t_max) const
+{
+	for (const auto& object : objects)
+	{
+		if (object->occluded(r, t_min, t_max))
+			return true;
+	}
+
+	return false;
+}
+
 bool HittableList::boundingBox(AABB& outputBox)
 {
 	if (objects.empty()) return false;
@@ -35,4 +46,35 @@ bool HittableList::boundingBox(AABB& outputBox)
 	}
 
 	return true;
+}
+
+float HittableList::area() const
+{
+	float total = 0.0f;
+
+	for (const auto& object : objects)
+		total += object->area();
+
+	return total;
+}
+
+surfaceSample HittableList::sampleSurface(Sampler& sampler) const
+{
+	float target = sampler.nextFloat() * area();
+	const Hittable* picked = nullptr;
+
+	for (const auto& object : objects)
+	{
+		float a = object->area();
+		if (a <= 0.0f)
+			continue;
+
+		picked = object.get();
+		if (target < a)
+			break;
+
+		target -= a;
+	}
+
+	return picked->sampleSurface(sampler);
 }
\ No newline at end of file
@@ -12,8 +12,15 @@ public:
 	void add(std::shared_ptr<Hittable> object) { objects.push_back(object); }
 
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	// Picks an object in proportion to its area, then a point on it
+	virtual float area() const override;
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
+	virtual std::vector<std::shared_ptr<Hittable>> split() const override { return objects; }
+
 	//std::vector<std::shared_ptr<Hittable>> getObjects() const { return objects; }
 
 public:
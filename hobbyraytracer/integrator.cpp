@@ -0,0 +1,1167 @@
+#include "hobbyraytracer.h"
+#include "integrator.h"
+
+#include "renderer.h"
+#include "material.h"
+
+#include <execution>
+#include <numeric>
+
+// Veach's power heuristic (beta = 2) for one sample from each strategy
+static float powerHeuristic(float pdf, float otherPdf)
+{
+	float a = pdf * pdf;
+	float b = otherPdf * otherPdf;
+
+	return a + b > 0.0f ? a / (a + b) : 0.0f;
+}
+
+glm::vec3 Integrator::backgroundColour(const Texture& background, const glm::vec3& direction)
+{
+	glm::vec2 uv = EnvironmentMap::directionToUV(direction);
+
+	return background.colourValue(uv.x, uv.y, glm::vec3(0));
+}
+
+bool Integrator::continuePath(int depth, BounceType type, bounceCounts& counts, glm::vec3& throughput, Sampler& sampler) const
+{
+	switch (type)
+	{
+	case BounceType::Diffuse:
+		if (++counts.diffuse > path.diffuseDepth) return false;
+		break;
+	case BounceType::Glossy:
+		if (++counts.glossy > path.glossyDepth) return false;
+		break;
+	case BounceType::Transmission:
+		if (++counts.transmission > path.transmissionDepth) return false;
+		break;
+	}
+
+	if (depth < path.rouletteDepth)
+		return true;
+
+	// Survive in proportion to the throughput, but never with certainty, and scale up whatever
+	// survives by the same amount so the estimate stays unbiased
+	float survive = glm::min(glm::max(throughput.x, glm::max(throughput.y, throughput.z)), 0.95f);
+
+	if (sampler.nextFloat() >= survive)
+		return false;
+
+	throughput /= survive;
+	return true;
+}
+
+glm::vec3 PathIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			result += currentAttenuation * backgroundColour(*ctx.background, r.dir);
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		result += currentAttenuation * rec.matPtr->emitted(rec.u, rec.v, rec.p);
+
+		bsdfSample s;
+		if (!rec.matPtr->sample(r, rec, sampler, s))
+			break;
+
+		currentAttenuation *= s.weight;
+
+		if (!continuePath(i, s.type, bounces, currentAttenuation, sampler))
+			break;
+
+		r = ray(rec.p, s.direction);
+	}
+
+	return result;
+}
+
+glm::vec3 NEEIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	// The camera counts as specular: nothing has sampled the lights for the first hit
+	bool specularBounce = true;
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			if (specularBounce || !ctx.lights->hasEnvironment())
+				result += currentAttenuation * backgroundColour(*ctx.background, r.dir);
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+
+		if (specularBounce || !ctx.lights->contains(&material))
+			result += currentAttenuation * material.emitted(rec.u, rec.v, rec.p);
+
+		bool specular = material.isSpecular(rec);
+
+		lightSample light;
+		if (!specular && ctx.lights->sample(rec.p, sampler, light))
+		{
+			glm::vec3 f = material.eval(r, rec, light.direction);
+
+			if (f != glm::vec3(0.0f))
+			{
+				stats.shadowRays++;
+
+				if (!ctx.world->occluded(ray(rec.p, light.direction), 0.001f, light.tMax))
+					result += currentAttenuation * f * light.Le / light.pdf;
+			}
+		}
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			break;
+
+		currentAttenuation *= s.weight;
+
+		if (!continuePath(i, s.type, bounces, currentAttenuation, sampler))
+			break;
+
+		specularBounce = specular;
+		r = ray(rec.p, s.direction);
+	}
+
+	return result;
+}
+
+glm::vec3 MISIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	// Density the BSDF drew the current ray with, 0 from the camera or a specular bounce
+	float bsdfPdf = 0.0f;
+	glm::vec3 origin = r.o;
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->hasEnvironment())
+				weight = powerHeuristic(bsdfPdf, ctx.lights->environmentPdf(r.dir));
+
+			result += currentAttenuation * backgroundColour(*ctx.background, r.dir) * weight;
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+		glm::vec3 emitted = material.emitted(rec.u, rec.v, rec.p);
+
+		if (emitted != glm::vec3(0.0f))
+		{
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->contains(&material))
+				weight = powerHeuristic(bsdfPdf, ctx.lights->pdf(origin, rec));
+
+			result += currentAttenuation * emitted * weight;
+		}
+
+		lightSample light;
+		if (!material.isSpecular(rec) && ctx.lights->sample(rec.p, sampler, light))
+		{
+			glm::vec3 f = material.eval(r, rec, light.direction);
+
+			if (f != glm::vec3(0.0f))
+			{
+				stats.shadowRays++;
+
+				if (!ctx.world->occluded(ray(rec.p, light.direction), 0.001f, light.tMax))
+				{
+					float weight = powerHeuristic(light.pdf, material.pdf(r, rec, light.direction));
+					result += currentAttenuation * f * light.Le * (weight / light.pdf);
+				}
+			}
+		}
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			break;
+
+		currentAttenuation *= s.weight;
+
+		if (!continuePath(i, s.type, bounces, currentAttenuation, sampler))
+			break;
+
+		bsdfPdf = s.pdf;
+		origin = rec.p;
+		r = ray(rec.p, s.direction);
+	}
+
+	return result;
+}
+
+// Samples a spatial cell has to see in a 1 spp training iteration before it's split, growing with
+// the square root of the iteration's length (Müller et al. 2017)
+constexpr float SPATIAL_SPLIT_SAMPLES = 12000.0f;
+
+// Share of a cell's flux above which a direction cell is subdivided
+constexpr float DIRECTIONAL_SPLIT_FLUX = 0.01f;
+
+void GuidedIntegrator::prepare(const AABB& sceneBounds)
+{
+	tree = std::make_unique<SDTree>(sceneBounds);
+
+	training = guiding.trainingSamples > 0;
+	iterationLength = 1.0f;
+	iterationEnd = 1.0f;
+}
+
+void GuidedIntegrator::endPass(float samplesPerPixel)
+{
+	if (!needsPasses() || samplesPerPixel < iterationEnd)
+		return;
+
+	uint64_t spatialThreshold = (uint64_t)(SPATIAL_SPLIT_SAMPLES * glm::sqrt(iterationLength));
+	tree->refine(spatialThreshold, DIRECTIONAL_SPLIT_FLUX, guiding.memoryLimit);
+
+	iterationLength *= 2.0f;
+	iterationEnd = samplesPerPixel + iterationLength;
+
+	// Stop once the next iteration would run past the training budget
+	if (iterationEnd > guiding.trainingSamples)
+	{
+		training = false;
+
+		std::cout << std::endl << "Path guiding: trained on " << samplesPerPixel << " samples per pixel, "
+			<< tree->memory() / 1024 << " KB" << std::endl;
+	}
+}
+
+glm::vec3 GuidedIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	// Density the current ray was drawn with, 0 from the camera or a specular bounce
+	float scatterPdf = 0.0f;
+	glm::vec3 origin = r.o;
+
+	// Bounces that get told what came back along them once the path is done
+	struct guideVertex
+	{
+		int cell;
+		glm::vec3 direction;
+		glm::vec3 throughput; // After this bounce, which everything arriving later is scaled by
+		float pdf;
+		glm::vec3 radiance = glm::vec3(0.0f);
+	};
+
+	// Cleared rather than rebuilt, as in BDPT, so each thread reuses the storage earlier paths grew
+	thread_local std::vector<guideVertex> vertices;
+	vertices.clear();
+
+	bool recording = needsPasses();
+
+	auto add = [&](const glm::vec3& contribution) {
+		result += contribution;
+
+		for (guideVertex& v : vertices)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (v.throughput[c] > 0.0f)
+					v.radiance[c] += contribution[c] / v.throughput[c];
+			}
+		}
+	};
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			float weight = 1.0f;
+			if (scatterPdf > 0.0f && ctx.lights->hasEnvironment())
+				weight = powerHeuristic(scatterPdf, ctx.lights->environmentPdf(r.dir));
+
+			add(currentAttenuation * backgroundColour(*ctx.background, r.dir) * weight);
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+		glm::vec3 emitted = material.emitted(rec.u, rec.v, rec.p);
+
+		if (emitted != glm::vec3(0.0f))
+		{
+			float weight = 1.0f;
+			if (scatterPdf > 0.0f && ctx.lights->contains(&material))
+				weight = powerHeuristic(scatterPdf, ctx.lights->pdf(origin, rec));
+
+			add(currentAttenuation * emitted * weight);
+		}
+
+		bool specular = material.isSpecular(rec);
+
+		// Before the first iteration is over there's nothing to guide with
+		int cell = !specular && tree ? tree->lookup(rec.p) : -1;
+		const DTree* guide = cell >= 0 && tree->sampling(cell).canSample() ? &tree->sampling(cell) : nullptr;
+		float guideFraction = guide ? 1.0f - guiding.bsdfFraction : 0.0f;
+
+		auto mixturePdf = [&](const glm::vec3& direction) {
+			float pdf = (1.0f - guideFraction) * material.pdf(r, rec, direction);
+			return guide ? pdf + guideFraction * guide->pdf(direction) : pdf;
+		};
+
+		lightSample light;
+		if (!specular && ctx.lights->sample(rec.p, sampler, light))
+		{
+			glm::vec3 f = material.eval(r, rec, light.direction);
+
+			if (f != glm::vec3(0.0f))
+			{
+				stats.shadowRays++;
+
+				if (!ctx.world->occluded(ray(rec.p, light.direction), 0.001f, light.tMax))
+				{
+					float weight = powerHeuristic(light.pdf, mixturePdf(light.direction));
+					add(currentAttenuation * f * light.Le * (weight / light.pdf));
+				}
+			}
+		}
+
+		glm::vec3 direction;
+		glm::vec3 weight;
+		float pdf;
+		BounceType type;
+
+		if (guide && sampler.nextFloat() < guideFraction)
+		{
+			direction = guide->sample(sampler);
+			type = material.bounceType(rec, direction);
+			pdf = mixturePdf(direction);
+			weight = pdf > 0.0f ? material.eval(r, rec, direction) / pdf : glm::vec3(0.0f);
+		}
+		else
+		{
+			bsdfSample s;
+			if (!material.sample(r, rec, sampler, s))
+				break;
+
+			direction = s.direction;
+			type = s.type;
+
+			// Delta lobes can't be guided, and keep the BSDF's own weight
+			if (s.pdf > 0.0f && guide)
+			{
+				pdf = mixturePdf(direction);
+				weight = material.eval(r, rec, direction) / pdf;
+			}
+			else
+			{
+				pdf = s.pdf;
+				weight = s.weight;
+			}
+		}
+
+		if (weight == glm::vec3(0.0f))
+			break;
+
+		currentAttenuation *= weight;
+
+		if (recording && cell >= 0 && pdf > 0.0f)
+			vertices.push_back({ cell, direction, currentAttenuation, pdf });
+
+		if (!continuePath(i, type, bounces, currentAttenuation, sampler))
+			break;
+
+		scatterPdf = pdf;
+		origin = rec.p;
+		r = ray(rec.p, direction);
+	}
+
+	// What came back along each bounce, divided by the density it was picked with, is an
+	// estimate of the flux the guide should learn for that direction
+	for (const guideVertex& v : vertices)
+		tree->building(v.cell).record(v.direction, luminance(v.radiance) / v.pdf);
+
+	return result;
+}
+
+// Without a radius in the scene, the first pass gathers from this fraction of the scene's diagonal
+constexpr float DEFAULT_PHOTON_RADIUS = 0.002f;
+
+// Share of the photons kept each pass as the radius shrinks (Knaus and Zwicker 2011)
+constexpr float PPM_ALPHA = 2.0f / 3.0f;
+
+// Photons traced together from one random stream, the unit of parallel work
+constexpr int PHOTON_BATCH = 4096;
+
+void PhotonIntegrator::prepare(const AABB& sceneBounds)
+{
+	initialRadius = photons.radius > 0.0f ? photons.radius
+		: DEFAULT_PHOTON_RADIUS * glm::length(sceneBounds.getMax() - sceneBounds.getMin());
+}
+
+void PhotonIntegrator::beginPass(const RenderContext& ctx, int pass, uint64_t seed)
+{
+	if (initialRadius <= 0.0f || photons.count <= 0)
+		return;
+
+	// r_i^2 = r_0^2 * prod_{k=1..i} (k + alpha) / (k + 1), Knaus and Zwicker's schedule with passes
+	// counted from 0: the second pass shrinks the area by (1 + alpha) / 2, not by alpha
+	float radiusSquared = initialRadius * initialRadius;
+
+	if (photons.progressive)
+	{
+		for (int k = 1; k <= pass; k++)
+			radiusSquared *= (k + PPM_ALPHA) / (k + 1);
+	}
+
+	int batches = (photons.count + PHOTON_BATCH - 1) / PHOTON_BATCH;
+
+	std::vector<std::vector<photon>> stored(batches);
+	std::vector<int> order(batches);
+	std::iota(order.begin(), order.end(), 0);
+
+	// Each batch draws from its own stream and keeps its own photons, so the map is the same
+	// whichever thread traced what
+	std::for_each(std::execution::par, order.begin(), order.end(), [&](int batch) {
+		IndependentSampler sampler(hashCombine(seed, batch));
+		int count = glm::min(PHOTON_BATCH, photons.count - batch * PHOTON_BATCH);
+
+		for (int i = 0; i < count; i++)
+			tracePhoton(ctx, sampler, stored[batch]);
+	});
+
+	std::vector<photon> all;
+
+	for (const std::vector<photon>& batch : stored)
+		all.insert(all.end(), batch.begin(), batch.end());
+
+	for (photon& p : all)
+		p.power /= (float)photons.count;
+
+	map.build(std::move(all), glm::sqrt(radiusSquared));
+	mapped = true;
+}
+
+void PhotonIntegrator::tracePhoton(const RenderContext& ctx, Sampler& sampler, std::vector<photon>& stored) const
+{
+	emissionSample emission;
+	if (!ctx.lights->sampleEmission(sampler, emission))
+		return;
+
+	ray r = emission.r;
+	glm::vec3 power = emission.power;
+
+	// Photons that land somewhere straight from the light are direct lighting, which the path
+	// tracer already handles better
+	bool caustic = false;
+
+	for (int depth = 0; depth < path.maxDepth; depth++)
+	{
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+			return;
+
+		const Material& material = *rec.matPtr;
+
+		if (!material.isSpecular(rec))
+		{
+			if (caustic)
+				stored.push_back({ rec.p, glm::normalize(rec.normal), -glm::normalize(r.dir), power });
+
+			return;
+		}
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			return;
+
+		power *= s.weight;
+
+		if (power == glm::vec3(0.0f))
+			return;
+
+		caustic = true;
+		r = ray(rec.p, s.direction);
+	}
+}
+
+glm::vec3 PhotonIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	// Density the BSDF drew the current ray with, 0 from the camera or a specular bounce
+	float bsdfPdf = 0.0f;
+	glm::vec3 origin = r.o;
+
+	// Whether the path has been through a non-specular vertex, and whether every bounce since the
+	// last one was specular. Lights found that way were in the photon map.
+	bool nonSpecularVertex = false;
+	bool caustic = false;
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			// The environment doesn't emit photons, so it's path traced as usual
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->hasEnvironment())
+				weight = powerHeuristic(bsdfPdf, ctx.lights->environmentPdf(r.dir));
+
+			result += currentAttenuation * backgroundColour(*ctx.background, r.dir) * weight;
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+		glm::vec3 emitted = material.emitted(rec.u, rec.v, rec.p);
+
+		if (emitted != glm::vec3(0.0f) && !(caustic && mapped && ctx.lights->contains(&material)))
+		{
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->contains(&material))
+				weight = powerHeuristic(bsdfPdf, ctx.lights->pdf(origin, rec));
+
+			result += currentAttenuation * emitted * weight;
+		}
+
+		bool specular = material.isSpecular(rec);
+
+		if (!specular && mapped)
+			result += currentAttenuation * map.estimate(r, rec);
+
+		lightSample light;
+		if (!specular && ctx.lights->sample(rec.p, sampler, light))
+		{
+			glm::vec3 f = material.eval(r, rec, light.direction);
+
+			if (f != glm::vec3(0.0f))
+			{
+				stats.shadowRays++;
+
+				if (!ctx.world->occluded(ray(rec.p, light.direction), 0.001f, light.tMax))
+				{
+					float weight = powerHeuristic(light.pdf, material.pdf(r, rec, light.direction));
+					result += currentAttenuation * f * light.Le * (weight / light.pdf);
+				}
+			}
+		}
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			break;
+
+		currentAttenuation *= s.weight;
+
+		if (!continuePath(i, s.type, bounces, currentAttenuation, sampler))
+			break;
+
+		nonSpecularVertex = nonSpecularVertex || !specular;
+		caustic = specular && nonSpecularVertex;
+
+		bsdfPdf = s.pdf;
+		origin = rec.p;
+		r = ray(rec.p, s.direction);
+	}
+
+	return result;
+}
+
+// Without a cell size in the scene, cache cells are this fraction of the scene's diagonal across
+constexpr float DEFAULT_CACHE_CELL_SIZE = 0.02f;
+
+// Cells in the cache's hash table, 16 MB
+constexpr size_t RADIANCE_CACHE_CELLS = 1 << 18;
+
+void CachedIntegrator::prepare(const AABB& sceneBounds)
+{
+	float cellSize = caching.cellSize > 0.0f ? caching.cellSize
+		: DEFAULT_CACHE_CELL_SIZE * glm::length(sceneBounds.getMax() - sceneBounds.getMin());
+
+	cache = cellSize > 0.0f ? std::make_unique<RadianceCache>(cellSize, RADIANCE_CACHE_CELLS) : nullptr;
+	filled = false;
+}
+
+void CachedIntegrator::endPass(float samplesPerPixel)
+{
+	if (!cache)
+		return;
+
+	cache->update();
+
+	if (!filled)
+	{
+		std::cout << std::endl << "Radiance cache: " << cache->usedCells() << " cells of " << cache->getCellSize()
+			<< " after the first pass, " << cache->memory() / 1024 << " KB" << std::endl;
+	}
+
+	filled = true;
+}
+
+glm::vec3 CachedIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::vec3 currentAttenuation = glm::vec3(1.0f);
+	glm::vec3 result = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	// Density the BSDF drew the current ray with, 0 from the camera or a specular bounce
+	float bsdfPdf = 0.0f;
+	glm::vec3 origin = r.o;
+
+	// Drawn every sample, so the dimensions after it line up whether or not the cache is ready
+	bool training = sampler.nextFloat() < caching.trainingFraction || !filled;
+	bool diffuseBounce = false;
+
+	// Non-specular vertices of a training path, told what left them once it's done
+	struct cacheVertex
+	{
+		glm::vec3 p;
+		glm::vec3 normal;
+		glm::vec3 throughput; // Arriving at the vertex, which everything leaving it is scaled by
+		glm::vec3 radiance = glm::vec3(0.0f);
+	};
+
+	// Cleared rather than rebuilt, as in BDPT, so each thread reuses the storage earlier paths grew
+	thread_local std::vector<cacheVertex> vertices;
+	vertices.clear();
+
+	auto add = [&](const glm::vec3& contribution) {
+		result += contribution;
+
+		for (cacheVertex& v : vertices)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				if (v.throughput[c] > 0.0f)
+					v.radiance[c] += contribution[c] / v.throughput[c];
+			}
+		}
+	};
+
+	for (int i = 0; i < path.maxDepth; ++i) {
+		if (i == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->hasEnvironment())
+				weight = powerHeuristic(bsdfPdf, ctx.lights->environmentPdf(r.dir));
+
+			add(currentAttenuation * backgroundColour(*ctx.background, r.dir) * weight);
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+		glm::vec3 emitted = material.emitted(rec.u, rec.v, rec.p);
+
+		if (emitted != glm::vec3(0.0f))
+		{
+			float weight = 1.0f;
+			if (bsdfPdf > 0.0f && ctx.lights->contains(&material))
+				weight = powerHeuristic(bsdfPdf, ctx.lights->pdf(origin, rec));
+
+			add(currentAttenuation * emitted * weight);
+		}
+
+		bool specular = material.isSpecular(rec);
+		glm::vec3 normal = glm::normalize(rec.normal);
+
+		// The cache holds what leaves a surface on top of its emission, which was just counted
+		if (!specular && !training && diffuseBounce)
+		{
+			glm::vec3 jitter = (glm::vec3(sampler.nextFloat(), sampler.nextFloat(), sampler.nextFloat()) - 0.5f) * cache->getCellSize();
+			jitter -= normal * glm::dot(jitter, normal);
+
+			glm::vec3 cached;
+			if (cache->lookup(rec.p + jitter, normal, (uint64_t)caching.cellSamples, cached))
+			{
+				result += currentAttenuation * cached;
+				break;
+			}
+		}
+
+		if (!specular && training && cache)
+			vertices.push_back({ rec.p, normal, currentAttenuation });
+
+		lightSample light;
+		if (!specular && ctx.lights->sample(rec.p, sampler, light))
+		{
+			glm::vec3 f = material.eval(r, rec, light.direction);
+
+			if (f != glm::vec3(0.0f))
+			{
+				stats.shadowRays++;
+
+				if (!ctx.world->occluded(ray(rec.p, light.direction), 0.001f, light.tMax))
+				{
+					float weight = powerHeuristic(light.pdf, material.pdf(r, rec, light.direction));
+					add(currentAttenuation * f * light.Le * (weight / light.pdf));
+				}
+			}
+		}
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			break;
+
+		currentAttenuation *= s.weight;
+
+		if (!continuePath(i, s.type, bounces, currentAttenuation, sampler))
+			break;
+
+		diffuseBounce = diffuseBounce || s.type == BounceType::Diffuse;
+
+		bsdfPdf = s.pdf;
+		origin = rec.p;
+		r = ray(rec.p, s.direction);
+	}
+
+	for (const cacheVertex& v : vertices)
+		cache->record(v.p, v.normal, v.radiance);
+
+	return result;
+}
+
+enum class PathVertexType
+{
+	Camera,
+	Light,
+	Surface
+};
+
+// A vertex of one of bidirectional path tracing's subpaths. Its densities are per unit area here:
+// pdfFwd of the subpath it's on reaching it, pdfRev of the other subpath reaching it from the
+// vertex after it.
+struct pathVertex
+{
+	PathVertexType type = PathVertexType::Surface;
+
+	glm::vec3 p;
+	glm::vec3 normal; // Unit length. A light's faces the way it emits, the lens' the way the camera looks.
+	glm::vec3 beta; // Throughput of the subpath up to this vertex, not including it
+
+	hitRecord rec; // Surfaces only
+
+	bool delta = false; // Specular, so nothing can be joined to it
+
+	float pdfFwd = 0.0f;
+	float pdfRev = 0.0f;
+};
+
+// From a density per solid angle at from to one per unit area at to
+static float toAreaDensity(const pathVertex& from, float pdf, const pathVertex& to)
+{
+	glm::vec3 w = to.p - from.p;
+	float distanceSquared = glm::dot(w, w);
+
+	if (distanceSquared <= 0.0f)
+		return 0.0f;
+
+	// Nothing lands on the lens, so its orientation doesn't come into it
+	if (to.type != PathVertexType::Camera)
+		pdf *= glm::abs(glm::dot(to.normal, w)) / glm::sqrt(distanceSquared);
+
+	return pdf / distanceSquared;
+}
+
+// sampleEmission() picks either face, then a cosine weighted direction from it
+static float lightDirectionPdf(const glm::vec3& normal, const glm::vec3& direction)
+{
+	return 0.5f * glm::abs(glm::dot(normal, glm::normalize(direction))) * glm::one_over_pi<float>();
+}
+
+// BSDF times the cosine towards next at a surface vertex reached from prev. The materials' BSDFs are
+// symmetric, so this serves light subpaths too.
+static glm::vec3 vertexEval(const pathVertex& v, const pathVertex& prev, const pathVertex& next)
+{
+	return v.rec.matPtr->eval(ray(prev.p, v.p - prev.p), v.rec, next.p - v.p);
+}
+
+// Area density at next of v sending its subpath there, having been reached from prev
+static float vertexPdf(const RenderContext& ctx, const pathVertex& v, const pathVertex* prev, const pathVertex& next, float filmArea)
+{
+	glm::vec3 w = next.p - v.p;
+	float pdf = 0.0f;
+
+	switch (v.type)
+	{
+	case PathVertexType::Camera:
+		pdf = ctx.camera.directionPdf(w, filmArea);
+		break;
+	case PathVertexType::Light:
+		pdf = lightDirectionPdf(v.normal, w);
+		break;
+	case PathVertexType::Surface:
+		if (!prev)
+			return 0.0f;
+
+		pdf = v.rec.matPtr->pdf(ray(prev->p, v.p - prev->p), v.rec, w);
+		break;
+	}
+
+	return toAreaDensity(v, pdf, next);
+}
+
+// Whether anything blocks the join from a to b. Both ends are left out by the same 0.001 every other
+// ray skips past its origin, however long the join is.
+static bool joinOccluded(const RenderContext& ctx, const glm::vec3& a, const glm::vec3& b)
+{
+	glm::vec3 d = b - a;
+	float distance = glm::length(d);
+
+	return distance > 0.0f && ctx.world->occluded(ray(a, d / distance), 0.001f, distance - 0.001f);
+}
+
+// Power heuristic weight of the path made by joining the first s light subpath vertices to the first
+// t camera subpath vertices, against every other split of the same path (Veach 1997, as laid out in
+// pbrt). When s or t is 1, sampled is the vertex picked for this join in place of the subpath's own.
+static float misWeight(const RenderContext& ctx, const std::vector<pathVertex>& cameraPath, const std::vector<pathVertex>& lightPath,
+	const pathVertex& sampled, int s, int t, float filmArea, bool splatting)
+{
+	if (s + t == 2)
+		return 1.0f;
+
+	struct densities
+	{
+		float fwd, rev;
+		bool delta;
+	};
+
+	// Copies, as joining changes what the vertices either side of it see. Every strategy of every
+	// sample needs them, so each thread keeps its own and only resizes it.
+	thread_local std::vector<densities> camera, light;
+	camera.resize(t);
+	light.resize(s);
+
+	for (int i = 0; i < t; i++)
+		camera[i] = { cameraPath[i].pdfFwd, cameraPath[i].pdfRev, cameraPath[i].delta };
+
+	for (int i = 0; i < s; i++)
+		light[i] = { lightPath[i].pdfFwd, lightPath[i].pdfRev, lightPath[i].delta };
+
+	const pathVertex& pt = t == 1 ? sampled : cameraPath[t - 1];
+	const pathVertex* ptMinus = t > 1 ? &cameraPath[t - 2] : nullptr;
+	const pathVertex* qs = s == 0 ? nullptr : (s == 1 ? &sampled : &lightPath[s - 1]);
+	const pathVertex* qsMinus = s > 1 ? &lightPath[s - 2] : nullptr;
+
+	if (t == 1)
+		camera[0] = { sampled.pdfFwd, 0.0f, false };
+
+	if (s == 1)
+		light[0] = { sampled.pdfFwd, 0.0f, false };
+
+	camera[t - 1].delta = false;
+
+	if (s > 0)
+	{
+		light[s - 1].delta = false;
+
+		camera[t - 1].rev = vertexPdf(ctx, *qs, qsMinus, pt, filmArea);
+		light[s - 1].rev = vertexPdf(ctx, pt, ptMinus, *qs, filmArea);
+
+		if (ptMinus)
+			camera[t - 2].rev = vertexPdf(ctx, pt, qs, *ptMinus, filmArea);
+
+		if (qsMinus)
+			light[s - 2].rev = vertexPdf(ctx, *qs, &pt, *qsMinus, filmArea);
+	}
+	else
+	{
+		// The camera subpath hit a light, where a light subpath could have started instead
+		camera[t - 1].rev = ctx.lights->emissionPdf(ptMinus->p, pt.rec);
+		camera[t - 2].rev = toAreaDensity(pt, lightDirectionPdf(pt.normal, ptMinus->p - pt.p), *ptMinus);
+	}
+
+	// Delta vertices have no density to compare, and can't be joined at either
+	auto remap = [](float pdf) { return pdf != 0.0f ? pdf * pdf : 1.0f; };
+
+	float sum = 0.0f;
+	float ratio = 1.0f;
+
+	for (int i = t - 1; i > 0; i--)
+	{
+		ratio *= remap(camera[i].rev) / remap(camera[i].fwd);
+
+		// i = 1 would join a light subpath to the lens, which needs a film to splat into
+		if (!camera[i].delta && !camera[i - 1].delta && (i > 1 || splatting))
+			sum += ratio;
+	}
+
+	ratio = 1.0f;
+
+	for (int i = s - 1; i >= 0; i--)
+	{
+		ratio *= remap(light[i].rev) / remap(light[i].fwd);
+
+		if (!light[i].delta && (i == 0 || !light[i - 1].delta))
+			sum += ratio;
+	}
+
+	return 1.0f / (1.0f + sum);
+}
+
+glm::vec3 BDPTIntegrator::walk(const RenderContext& ctx, ray r, glm::vec3 beta, float pdf, int maxVertices, bool fromCamera,
+	Sampler& sampler, RayStats& stats, std::vector<pathVertex>& vertices) const
+{
+	glm::vec3 escaped = glm::vec3(0.0f);
+	bounceCounts bounces;
+
+	for (int depth = 0; depth < maxVertices; depth++)
+	{
+		if (fromCamera && depth == 0) stats.primaryRays++;
+		else stats.secondaryRays++;
+
+		hitRecord rec;
+		if (!ctx.world->hit(r, 0.001f, INFINITY, rec))
+		{
+			// Weighed against sampling the environment, as MISIntegrator does, unless the camera
+			// or a specular bounce sent the ray
+			if (fromCamera)
+			{
+				float weight = 1.0f;
+				if (depth > 0 && pdf > 0.0f && ctx.lights->hasEnvironment())
+					weight = powerHeuristic(pdf, ctx.lights->environmentPdf(r.dir));
+
+				escaped += beta * backgroundColour(*ctx.background, r.dir) * weight;
+			}
+
+			break;
+		}
+
+		stats.shadingEvents++;
+
+		const Material& material = *rec.matPtr;
+
+		pathVertex v;
+		v.p = rec.p;
+		v.normal = glm::normalize(rec.normal);
+		v.beta = beta;
+		v.rec = rec;
+		v.delta = material.isSpecular(rec);
+		v.pdfFwd = toAreaDensity(vertices.back(), pdf, v);
+
+		vertices.push_back(v);
+
+		bsdfSample s;
+		if (!material.sample(r, rec, sampler, s))
+			break;
+
+		// How likely the bounce back the other way would have been, for the vertex before
+		float pdfRev = s.pdf > 0.0f ? material.pdf(ray(rec.p + s.direction, -s.direction), rec, -r.dir) : 0.0f;
+
+		beta *= s.weight;
+		pdf = s.pdf;
+
+		if (beta == glm::vec3(0.0f) || !continuePath(depth, s.type, bounces, beta, sampler))
+			break;
+
+		size_t last = vertices.size() - 1;
+		vertices[last - 1].pdfRev = toAreaDensity(vertices[last], pdfRev, vertices[last - 1]);
+
+		r = ray(rec.p, s.direction);
+	}
+
+	return escaped;
+}
+
+glm::vec3 BDPTIntegrator::Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const
+{
+	glm::ivec2 dimensions = ctx.film ? ctx.film->getFilm().dimensions : glm::ivec2(0);
+	bool splatting = dimensions.x > 1 && dimensions.y > 1;
+
+	// renderPixel spreads (s, t) over a (W - 1) x (H - 1) grid of pixels across the viewport, and
+	// W x H of them get sampled
+	float filmArea = splatting
+		? ctx.camera.getViewportArea() * ((float)dimensions.x * dimensions.y) / ((float)(dimensions.x - 1) * (dimensions.y - 1))
+		: 1.0f;
+
+	glm::vec3 result = glm::vec3(0.0f);
+
+	// Cleared rather than rebuilt, so after the first few samples a thread's subpaths reuse the
+	// storage earlier ones grew to
+	thread_local std::vector<pathVertex> cameraPath;
+	thread_local std::vector<pathVertex> lightPath;
+	cameraPath.clear();
+	lightPath.clear();
+
+	pathVertex lens;
+	lens.type = PathVertexType::Camera;
+	lens.p = r.o;
+	lens.normal = ctx.camera.getForward();
+	lens.beta = glm::vec3(1.0f);
+
+	cameraPath.push_back(lens);
+	result += walk(ctx, r, glm::vec3(1.0f), ctx.camera.directionPdf(r.dir, filmArea), path.maxDepth, true, sampler, stats, cameraPath);
+
+	emissionSample emission;
+	if (ctx.lights->sampleEmission(sampler, emission) && emission.positionPdf > 0.0f && emission.directionPdf > 0.0f)
+	{
+		pathVertex light;
+		light.type = PathVertexType::Light;
+		light.p = emission.r.o;
+		light.normal = emission.normal;
+		light.beta = emission.Le / emission.positionPdf;
+		light.pdfFwd = emission.positionPdf;
+
+		lightPath.push_back(light);
+		walk(ctx, emission.r, emission.power, emission.directionPdf, path.maxDepth - 1, false, sampler, stats, lightPath);
+	}
+
+	pathVertex sampled;
+
+	// s light subpath vertices joined to t camera subpath vertices, s + t - 1 rays in all. s = 1
+	// picks a fresh point on a light for each camera vertex, and t = 1 a fresh point on the lens.
+	for (int t = 1; t <= (int)cameraPath.size(); t++)
+	{
+		for (int s = 0; s <= glm::max((int)lightPath.size(), 1); s++)
+		{
+			if (s + t < 2 || (s == 1 && t == 1) || s + t - 1 > path.maxDepth || (t == 1 && !splatting))
+				continue;
+
+			if (s == 0)
+			{
+				const pathVertex& pt = cameraPath[t - 1];
+				glm::vec3 emitted = pt.rec.matPtr->emitted(pt.rec.u, pt.rec.v, pt.rec.p);
+
+				if (emitted == glm::vec3(0.0f))
+					continue;
+
+				// Lights that can't be sampled are only ever found this way
+				float weight = ctx.lights->contains(pt.rec.matPtr.get()) ? misWeight(ctx, cameraPath, lightPath, sampled, 0, t, filmArea, splatting) : 1.0f;
+
+				result += pt.beta * emitted * weight;
+			}
+			else if (t == 1)
+			{
+				const pathVertex& qs = lightPath[s - 1];
+				if (qs.delta)
+					continue;
+
+				sampled = lens;
+				sampled.p = ctx.camera.sampleLens(sampler);
+
+				glm::vec2 st;
+				if (!ctx.camera.project(sampled.p, qs.p, st))
+					continue;
+
+				// The inverse of renderPixel's mapping, which flips rows
+				glm::vec2 pixel(std::floor(st.x * (dimensions.x - 1)), dimensions.y - std::floor(st.y * (dimensions.y - 1)));
+
+				glm::vec3 toLens = sampled.p - qs.p;
+				float importance = ctx.camera.directionPdf(-toLens, filmArea) / glm::dot(toLens, toLens);
+				glm::vec3 L = qs.beta * vertexEval(qs, lightPath[s - 2], sampled) * importance;
+
+				if (L == glm::vec3(0.0f))
+					continue;
+
+				stats.shadowRays++;
+
+				if (joinOccluded(ctx, qs.p, sampled.p))
+					continue;
+
+				ctx.film->addSplat(pixel, L * misWeight(ctx, cameraPath, lightPath, sampled, s, 1, filmArea, splatting));
+			}
+			else if (s == 1)
+			{
+				const pathVertex& pt = cameraPath[t - 1];
+				if (pt.delta)
+					continue;
+
+				lightSample light;
+				if (!ctx.lights->sample(pt.p, sampler, light))
+					continue;
+
+				ray toPt(cameraPath[t - 2].p, pt.p - cameraPath[t - 2].p);
+				glm::vec3 f = pt.rec.matPtr->eval(toPt, pt.rec, light.direction);
+
+				if (f == glm::vec3(0.0f))
+					continue;
+
+				stats.shadowRays++;
+
+				if (ctx.world->occluded(ray(pt.p, light.direction), 0.001f, light.tMax))
+					continue;
+
+				float weight;
+
+				if (light.tMax == INFINITY)
+				{
+					weight = powerHeuristic(light.pdf, pt.rec.matPtr->pdf(toPt, pt.rec, light.direction));
+				}
+				else
+				{
+					sampled.type = PathVertexType::Light;
+					sampled.p = light.p;
+					sampled.normal = glm::normalize(light.normal);
+					sampled.pdfFwd = light.emissionPdf;
+
+					weight = misWeight(ctx, cameraPath, lightPath, sampled, 1, t, filmArea, splatting);
+				}
+
+				result += pt.beta * f * light.Le * (weight / light.pdf);
+			}
+			else
+			{
+				const pathVertex& pt = cameraPath[t - 1];
+				const pathVertex& qs = lightPath[s - 1];
+
+				if (pt.delta || qs.delta)
+					continue;
+
+				glm::vec3 d = qs.p - pt.p;
+				glm::vec3 L = qs.beta * vertexEval(qs, lightPath[s - 2], pt) * vertexEval(pt, cameraPath[t - 2], qs) * pt.beta
+					/ glm::dot(d, d);
+
+				if (L == glm::vec3(0.0f))
+					continue;
+
+				stats.shadowRays++;
+
+				if (joinOccluded(ctx, pt.p, qs.p))
+					continue;
+
+				result += L * misWeight(ctx, cameraPath, lightPath, sampled, s, t, filmArea, splatting);
+			}
+		}
+	}
+
+	return result;
+}
\ No newline at end of file
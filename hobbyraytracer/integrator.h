@@ -0,0 +1,215 @@
+#pragma once
+
+#include "hittable.h"
+#include "texture.h"
+#include "telemetry.h"
+#include "material.h"
+#include "sdTree.h"
+#include "photonMap.h"
+#include "radianceCache.h"
+
+struct RenderContext;
+struct pathVertex;
+
+// How long paths may get. Each bounce counts against maxDepth and against the limit for its
+// kind; from rouletteDepth on, paths are ended at random in proportion to how little they carry.
+struct path_desc
+{
+	int maxDepth = 50; // Rays traced per camera sample, including the first
+	int diffuseDepth = 50;
+	int glossyDepth = 50;
+	int transmissionDepth = 50;
+
+	int rouletteDepth = 3; // Bounces before Russian roulette starts, >= maxDepth turns it off
+};
+
+// Estimates the radiance arriving along a camera ray. Picked per scene with `integrator: type`.
+class Integrator
+{
+public:
+	Integrator(path_desc desc) : path(desc) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const = 0;
+
+	// Integrators that learn from what they render, or that change between passes, are given the
+	// scene's bounds once it's loaded. beginPass is called before every progressive pass with its
+	// index (counting from 0, carried on by resumed renders) and a seed for it, and endPass after
+	// it with how many samples per pixel have been taken on average. All are called with no
+	// render in flight.
+	virtual void prepare(const AABB& sceneBounds) { }
+	virtual void beginPass(const RenderContext& ctx, int pass, uint64_t seed) { }
+	virtual void endPass(float samplesPerPixel) { }
+
+	// True while beginPass or endPass have work to do, so the render has to go in passes
+	virtual bool needsPasses() const { return false; }
+
+protected:
+	// Lookup of the background texture in the polar layout environment maps use
+	static glm::vec3 backgroundColour(const Texture& background, const glm::vec3& direction);
+
+	struct bounceCounts
+	{
+		int diffuse = 0, glossy = 0, transmission = 0;
+	};
+
+	// Called once a bounce has scaled throughput, depth being its vertex (0 for the camera ray's
+	// hit): counts it against its limit and plays Russian roulette, dividing throughput by the
+	// survival probability. False ends the path.
+	bool continuePath(int depth, BounceType type, bounceCounts& counts, glm::vec3& throughput, Sampler& sampler) const;
+
+	path_desc path;
+};
+
+// Plain path tracing: follows scatter() and only finds lights by hitting them
+class PathIntegrator : public Integrator
+{
+public:
+	PathIntegrator(path_desc desc) : Integrator(desc) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+};
+
+// Path tracing with next-event estimation: every non-specular vertex also connects to a point
+// sampled on a light with a shadow ray. Emission found by the scattered ray is then only
+// counted for lights the list can't sample, or after a specular bounce.
+class NEEIntegrator : public Integrator
+{
+public:
+	NEEIntegrator(path_desc desc) : Integrator(desc) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+};
+
+// Next-event estimation and BSDF sampling together: both strategies can reach a light, and each
+// contribution is weighted by the power heuristic over their densities, so neither small lights
+// nor sharp glossy lobes leave fireflies
+class MISIntegrator : public Integrator
+{
+public:
+	MISIntegrator(path_desc desc) : Integrator(desc) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+};
+
+struct guiding_desc
+{
+	int trainingSamples = 32; // Samples per pixel spent learning, after which the guide is left as it is
+	float bsdfFraction = 0.5f; // Chance of sampling the BSDF rather than the guide, must be above 0
+	size_t memoryLimit = 256 << 20; // Bytes the SD-tree may grow to
+};
+
+// Practical path guiding (Müller et al. 2017) on top of MIS path tracing. Non-specular bounces
+// draw their direction from either the BSDF or an SD-tree of the incident radiance learned so far,
+// weighted by one sample MIS over the two densities. Every bounce also records what came back
+// along it. The tree is refined at the end of training iterations that double in length,
+// starting at 1 sample per pixel, until trainingSamples is reached.
+class GuidedIntegrator : public Integrator
+{
+public:
+	GuidedIntegrator(path_desc desc, guiding_desc guiding) : Integrator(desc), guiding(guiding) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+
+	virtual void prepare(const AABB& sceneBounds) override;
+	virtual void endPass(float samplesPerPixel) override;
+	virtual bool needsPasses() const override { return tree && training; }
+
+private:
+	guiding_desc guiding;
+
+	std::unique_ptr<SDTree> tree;
+
+	bool training = true;
+	float iterationLength = 1.0f; // Samples per pixel in the current training iteration
+	float iterationEnd = 1.0f;
+};
+
+struct photon_desc
+{
+	int count = 200000; // Photons emitted per pass
+	float radius = 0.0f; // Gather radius for the first pass, 0 = a fraction of the scene's size
+	bool progressive = true; // Shrink the radius every pass, so the image converges to the right answer
+};
+
+// MIS path tracing with a caustic photon map (Jensen 1996). Before every pass photons are shot
+// from the lights in parallel, and those that reach a non-specular surface through at least one
+// specular one are stored. Non-specular vertices add the radiance the map estimates there, and
+// paths leave out the light they'd find through a chain of specular bounces after one, so
+// nothing is counted twice. Progressively the gather radius shrinks each pass as in Knaus and
+// Zwicker's probabilistic PPM, so the bias of the density estimate goes to zero as passes add up.
+class PhotonIntegrator : public Integrator
+{
+public:
+	PhotonIntegrator(path_desc desc, photon_desc photons) : Integrator(desc), photons(photons) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+
+	virtual void prepare(const AABB& sceneBounds) override;
+	virtual void beginPass(const RenderContext& ctx, int pass, uint64_t seed) override;
+	virtual bool needsPasses() const override { return true; }
+
+private:
+	// Follows one photon from a light, adding it to stored if it lands on a caustic
+	void tracePhoton(const RenderContext& ctx, Sampler& sampler, std::vector<photon>& stored) const;
+
+	photon_desc photons;
+
+	float initialRadius = 0.0f;
+
+	PhotonMap map;
+	bool mapped = false; // Until a map is built, e.g. on a distributed worker, caustics are path traced
+};
+
+struct cache_desc
+{
+	float cellSize = 0.0f; // Width of a cache cell, 0 = a fraction of the scene's size
+	float trainingFraction = 0.1f; // Share of paths traced in full to fill the cache, above 0
+	int cellSamples = 16; // Samples a cell needs before paths end in it
+};
+
+// MIS path tracing that ends paths in a radiance cache after their first diffuse bounce, for
+// interiors where almost all the time goes on smooth indirect light. trainingFraction of paths
+// are traced in full and record the radiance leaving each non-specular vertex into a hashed
+// world-space grid; the rest add the cached radiance at the first vertex a diffuse bounce reaches
+// and stop there. What was recorded becomes visible after every pass, so the cache fills in
+// progressively. Lookups are jittered over the cell in the surface's plane, which turns the blocky
+// bias of the grid into noise.
+class CachedIntegrator : public Integrator
+{
+public:
+	CachedIntegrator(path_desc desc, cache_desc caching) : Integrator(desc), caching(caching) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+
+	virtual void prepare(const AABB& sceneBounds) override;
+	virtual void endPass(float samplesPerPixel) override;
+	virtual bool needsPasses() const override { return cache != nullptr; }
+
+private:
+	cache_desc caching;
+
+	std::unique_ptr<RadianceCache> cache;
+	bool filled = false; // Until the first pass ends, or on a distributed worker, every path is traced in full
+};
+
+// Bidirectional path tracing (Veach 1997). Every camera sample also traces a subpath from a light
+// and joins each vertex of one to each vertex of the other, as well as taking the paths either
+// finds on its own. All the ways the same path could have been built are weighed against each
+// other with the power heuristic, so a light inside a fixture, which camera paths only find by
+// squeezing through its opening, is reached from the light's side instead. Light subpath vertices
+// joined straight to the lens land in other pixels, and are splatted into the film; without a
+// film (on a distributed worker) those joins are left out of the weights. The environment can't
+// start a light subpath, so it's lit by MIS along the camera subpath as in MISIntegrator.
+class BDPTIntegrator : public Integrator
+{
+public:
+	BDPTIntegrator(path_desc desc) : Integrator(desc) { }
+
+	virtual glm::vec3 Li(ray r, const RenderContext& ctx, Sampler& sampler, RayStats& stats) const override;
+
+private:
+	// Extends a subpath from its last vertex along r, which was picked with solid angle density pdf,
+	// by at most maxVertices. A camera subpath returns the environment light it escapes to.
+	glm::vec3 walk(const RenderContext& ctx, ray r, glm::vec3 beta, float pdf, int maxVertices, bool fromCamera,
+		Sampler& sampler, RayStats& stats, std::vector<pathVertex>& vertices) const;
+};
\ No newline at end of file
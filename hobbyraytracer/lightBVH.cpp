@@ -0,0 +1,403 @@
+#include "hobbyraytracer.h"
+#include "lightBVH.h"
+
+#include <algorithm>
+#include <numeric>
+
+// Centroid buckets tried per axis when splitting a node
+constexpr int LIGHT_BVH_BUCKETS = 12;
+
+// How far either side of a hit point to look for which instance of a light it landed on
+constexpr float PROBE_OFFSET = 1e-3f;
+
+constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+static float safeSqrt(float x)
+{
+	return std::sqrt(glm::max(x, 0.0f));
+}
+
+static float safeAcos(float x)
+{
+	return std::acos(glm::clamp(x, -1.0f, 1.0f));
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of a and b
+static float cosSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return cosA > cosB ? 1.0f : cosA * cosB + sinA * sinB;
+}
+
+static float sinSubClamped(float sinA, float cosA, float sinB, float cosB)
+{
+	return cosA > cosB ? 0.0f : sinA * cosB - cosA * sinB;
+}
+
+static glm::vec3 centre(const AABB& box)
+{
+	return (box.getMin() + box.getMax()) * 0.5f;
+}
+
+static bool contains(const AABB& box, const glm::vec3& p, float margin)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		if (p[a] < box.getMin()[a] - margin || p[a] > box.getMax()[a] + margin)
+			return false;
+	}
+
+	return true;
+}
+
+static float surfaceArea(const AABB& box)
+{
+	glm::vec3 d = box.getMax() - box.getMin();
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// Solid angle measure of the directions lit by emitters with normals in a cone of cosTheta,
+// each lighting the hemisphere around its normal
+static float orientationMeasure(float cosTheta)
+{
+	float pi = glm::pi<float>();
+
+	float thetaO = safeAcos(cosTheta);
+	float thetaW = glm::min(thetaO + 0.5f * pi, pi);
+	float sinO = std::sin(thetaO);
+
+	return 2.0f * pi * (1.0f - cosTheta)
+		+ 0.5f * pi * (2.0f * thetaW * sinO - std::cos(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinO + cosTheta);
+}
+
+float lightBounds::importance(const glm::vec3& p) const
+{
+	if (power <= 0.0f)
+		return 0.0f;
+
+	glm::vec3 diagonal = bounds.getMax() - bounds.getMin();
+	glm::vec3 toPoint = p - centre(bounds);
+
+	float distanceSquared = glm::dot(toPoint, toPoint);
+	float distance = glm::sqrt(distanceSquared);
+
+	// Angle from the axis to p, either way along it
+	float cosW = distance > 0.0f ? glm::abs(glm::dot(axis, toPoint)) / distance : 1.0f;
+	float sinW = safeSqrt(1.0f - cosW * cosW);
+
+	// Half angle the bounds subtend from p, everything if p is inside them
+	float radiusSquared = 0.25f * glm::dot(diagonal, diagonal);
+	float cosB = distanceSquared > radiusSquared ? safeSqrt(1.0f - radiusSquared / distanceSquared) : -1.0f;
+	float sinB = safeSqrt(1.0f - cosB * cosB);
+
+	float sinO = safeSqrt(1.0f - cosTheta * cosTheta);
+
+	// Smallest possible angle between an emitter's normal and the direction to p
+	float cosX = cosSubClamped(sinW, cosW, sinO, cosTheta);
+	float sinX = sinSubClamped(sinW, cosW, sinO, cosTheta);
+	float cosClosest = cosSubClamped(sinX, cosX, sinB, cosB);
+
+	// Diffuse emitters don't light anything edge on or behind them
+	if (cosClosest <= 0.0f)
+		return 0.0f;
+
+	// Clamped so points inside or right next to a node don't swamp everything else
+	return power * cosClosest / glm::max(distanceSquared, 0.5f * glm::length(diagonal));
+}
+
+lightBounds lightBounds::merge(const lightBounds& a, const lightBounds& b)
+{
+	lightBounds merged;
+	merged.bounds = AABB::surroundingBox(a.bounds, b.bounds);
+	merged.power = a.power + b.power;
+
+	// Normals go either way, so turn b to face the same side as a before joining the cones
+	glm::vec3 bAxis = glm::dot(a.axis, b.axis) < 0.0f ? -b.axis : b.axis;
+
+	float thetaA = safeAcos(a.cosTheta);
+	float thetaB = safeAcos(b.cosTheta);
+	float thetaD = safeAcos(glm::dot(a.axis, bAxis));
+
+	if (glm::min(thetaD + thetaB, glm::pi<float>()) <= thetaA)
+	{
+		merged.axis = a.axis;
+		merged.cosTheta = a.cosTheta;
+		return merged;
+	}
+
+	if (glm::min(thetaD + thetaA, glm::pi<float>()) <= thetaB)
+	{
+		merged.axis = bAxis;
+		merged.cosTheta = b.cosTheta;
+		return merged;
+	}
+
+	// Past 90 degrees a two sided cone already holds every direction
+	float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+	glm::vec3 rotationAxis = glm::cross(a.axis, bAxis);
+
+	if (thetaO >= 0.5f * glm::pi<float>() || glm::dot(rotationAxis, rotationAxis) < 1e-12f)
+		return merged;
+
+	// Rotate a's axis towards b's until the cone just holds both (Rodrigues' formula)
+	glm::vec3 k = glm::normalize(rotationAxis);
+	float phi = thetaO - thetaA;
+
+	merged.axis = glm::normalize(a.axis * std::cos(phi) + glm::cross(k, a.axis) * std::sin(phi)
+		+ k * glm::dot(k, a.axis) * (1.0f - std::cos(phi)));
+	merged.cosTheta = std::cos(thetaO);
+
+	return merged;
+}
+
+void LightBVH::build(std::vector<lightPrimitive> lights)
+{
+	nodes.clear();
+	byObject.clear();
+	primitives = std::move(lights);
+	leaves.assign(primitives.size(), -1);
+
+	if (primitives.empty())
+		return;
+
+	std::vector<int> order(primitives.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	nodes.reserve(2 * primitives.size() - 1);
+	buildRecursive(order, 0, (int)order.size());
+
+	for (int i = 0; i < size(); i++)
+		byObject.push_back({ primitives[i].surface->primitive(), i });
+
+	std::sort(byObject.begin(), byObject.end(), byObjectOrder);
+}
+
+int LightBVH::buildRecursive(std::vector<int>& order, int begin, int end)
+{
+	lightBounds bounds = primitives[order[begin]].bounds;
+	AABB centroids(centre(bounds.bounds), centre(bounds.bounds));
+
+	for (int i = begin + 1; i < end; i++)
+	{
+		const lightBounds& light = primitives[order[i]].bounds;
+		glm::vec3 c = centre(light.bounds);
+
+		bounds = lightBounds::merge(bounds, light);
+		centroids = AABB::surroundingBox(centroids, AABB(c, c));
+	}
+
+	int index = (int)nodes.size();
+	nodes.push_back({ bounds });
+
+	if (end - begin == 1)
+	{
+		nodes[index].primitive = order[begin];
+		leaves[order[begin]] = index;
+		return index;
+	}
+
+	glm::vec3 extent = bounds.bounds.getMax() - bounds.bounds.getMin();
+	float maxExtent = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+	glm::vec3 centroidMin = centroids.getMin();
+	glm::vec3 centroidExtent = centroids.getMax() - centroidMin;
+
+	auto bucketOf = [&](int primitive, int axis) {
+		float offset = (centre(primitives[primitive].bounds.bounds)[axis] - centroidMin[axis]) / centroidExtent[axis];
+		return glm::min((int)(LIGHT_BVH_BUCKETS * offset), LIGHT_BVH_BUCKETS - 1);
+	};
+
+	// Surface area orientation heuristic: power times the spread of directions lit times the
+	// area of the bounds, summed over both sides of each bucket boundary
+	float bestCost = INFINITY;
+	int bestAxis = -1;
+	int bestSplit = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (centroidExtent[axis] <= 0.0f)
+			continue;
+
+		std::array<lightBounds, LIGHT_BVH_BUCKETS> buckets;
+		std::array<int, LIGHT_BVH_BUCKETS> counts{};
+
+		for (int i = begin; i < end; i++)
+		{
+			int b = bucketOf(order[i], axis);
+			const lightBounds& light = primitives[order[i]].bounds;
+
+			buckets[b] = counts[b]++ ? lightBounds::merge(buckets[b], light) : light;
+		}
+
+		auto cost = [&](int first, int last) {
+			lightBounds side;
+			bool any = false;
+
+			for (int b = first; b < last; b++)
+			{
+				if (!counts[b])
+					continue;
+
+				side = any ? lightBounds::merge(side, buckets[b]) : buckets[b];
+				any = true;
+			}
+
+			return any ? side.power * orientationMeasure(side.cosTheta) * surfaceArea(side.bounds) : 0.0f;
+		};
+
+		// Splitting a long node across its short side isn't as good as it looks
+		float regularise = maxExtent / glm::max(extent[axis], 1e-6f);
+
+		int below = 0;
+		for (int split = 1; split < LIGHT_BVH_BUCKETS; split++)
+		{
+			below += counts[split - 1];
+			if (below == 0 || below == end - begin)
+				continue;
+
+			float c = regularise * (cost(0, split) + cost(split, LIGHT_BVH_BUCKETS));
+			if (c < bestCost)
+			{
+				bestCost = c;
+				bestAxis = axis;
+				bestSplit = split;
+			}
+		}
+	}
+
+	int mid = (begin + end) / 2;
+
+	// Every centroid in the same place leaves nothing to choose between, so just halve them
+	if (bestAxis >= 0)
+	{
+		mid = (int)(std::partition(order.begin() + begin, order.begin() + end,
+			[&](int primitive) { return bucketOf(primitive, bestAxis) < bestSplit; }) - order.begin());
+	}
+
+	buildRecursive(order, begin, mid);
+
+	int second = buildRecursive(order, mid, end);
+	nodes[index].secondChild = second;
+
+	return index;
+}
+
+bool LightBVH::childProbabilities(int node, const glm::vec3& p, float& first) const
+{
+	float a = nodes[node + 1].bounds.importance(p);
+	float b = nodes[nodes[node].secondChild].bounds.importance(p);
+
+	if (a + b <= 0.0f)
+		return false;
+
+	first = a / (a + b);
+	return true;
+}
+
+const lightPrimitive* LightBVH::sample(const glm::vec3& p, float u, float& pmf) const
+{
+	if (empty())
+		return nullptr;
+
+	int node = 0;
+	pmf = 1.0f;
+
+	while (nodes[node].primitive < 0)
+	{
+		float first;
+		if (!childProbabilities(node, p, first))
+			return nullptr;
+
+		if (u < first)
+		{
+			u = glm::min(u / first, ONE_MINUS_EPSILON);
+			pmf *= first;
+			node = node + 1;
+		}
+		else
+		{
+			u = glm::min((u - first) / (1.0f - first), ONE_MINUS_EPSILON);
+			pmf *= 1.0f - first;
+			node = nodes[node].secondChild;
+		}
+	}
+
+	return &primitives[nodes[node].primitive];
+}
+
+const lightPrimitive* LightBVH::find(const glm::vec3& p, const hitRecord& rec, float& pmf) const
+{
+	if (empty())
+		return nullptr;
+
+	int light = primitiveOf(rec);
+	if (light < 0)
+		return nullptr;
+
+	// Its probability is the product of the choices on the way down to its leaf, as in sample().
+	// Nodes are laid out depth first, so the first child's subtree is everything before the second.
+	int leaf = leaves[light];
+	int node = 0;
+	pmf = 1.0f;
+
+	while (node != leaf)
+	{
+		float first;
+		if (!childProbabilities(node, p, first))
+			return nullptr;
+
+		if (leaf < nodes[node].secondChild)
+		{
+			pmf *= first;
+			node = node + 1;
+		}
+		else
+		{
+			pmf *= 1.0f - first;
+			node = nodes[node].secondChild;
+		}
+	}
+
+	return pmf > 0.0f ? &primitives[light] : nullptr;
+}
+
+bool LightBVH::byObjectOrder(const std::pair<const Hittable*, int>& a, const std::pair<const Hittable*, int>& b)
+{
+	return std::less<const Hittable*>()(a.first, b.first);
+}
+
+int LightBVH::primitiveOf(const hitRecord& rec) const
+{
+	auto [begin, end] = std::equal_range(byObject.begin(), byObject.end(), std::make_pair(rec.object, 0), byObjectOrder);
+
+	int match = -1;
+	int matches = 0;
+
+	for (auto i = begin; i != end; i++)
+	{
+		const lightPrimitive& light = primitives[i->second];
+
+		if (light.material == rec.matPtr && contains(light.bounds.bounds, rec.p, PROBE_OFFSET))
+		{
+			match = i->second;
+			matches++;
+		}
+	}
+
+	if (matches <= 1)
+		return match;
+
+	// Overlapping instances of one object, the one that was hit is the one a tiny ray back
+	// through the hit point crosses. Only whether it does matters, not where.
+	ray probe(rec.p + rec.normal * PROBE_OFFSET, -rec.normal);
+
+	for (auto i = begin; i != end; i++)
+	{
+		const lightPrimitive& light = primitives[i->second];
+
+		if (light.material == rec.matPtr && contains(light.bounds.bounds, rec.p, PROBE_OFFSET)
+			&& light.surface->occluded(probe, 0.0f, 2.0f * PROBE_OFFSET))
+			return i->second;
+	}
+
+	return -1;
+}
\ No newline at end of file
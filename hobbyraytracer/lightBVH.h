@@ -0,0 +1,78 @@
+#pragma once
+
+#include "hittable.h"
+
+// Conservative bounds on a set of emitting surfaces: where they are, how much they emit and
+// which way they face. Emitters are two sided, so the cone holds normals either way along axis.
+struct lightBounds
+{
+	AABB bounds;
+	float power = 0.0f;
+
+	glm::vec3 axis = glm::vec3(0.0f, 0.0f, 1.0f);
+	float cosTheta = -1.0f; // -1 = facing every way
+
+	// Estimate of how much the lights contribute at p, zero only if they can't light it at all
+	float importance(const glm::vec3& p) const;
+
+	static lightBounds merge(const lightBounds& a, const lightBounds& b);
+};
+
+// One piece of an emitter, a leaf of the light BVH
+struct lightPrimitive
+{
+	std::shared_ptr<Hittable> surface;
+	std::shared_ptr<Material> material;
+
+	float area = 0.0f;
+	lightBounds bounds;
+};
+
+// Bounding volume hierarchy over the scene's emitters (Conty Estevez & Kulla 2018, as in pbrt-v4).
+// Each node bounds its lights' power and orientation, so a light can be picked in O(log n) with
+// probability roughly proportional to its contribution at the shading point.
+class LightBVH
+{
+public:
+	// Built with the surface area orientation heuristic, one primitive per leaf
+	void build(std::vector<lightPrimitive> lights);
+
+	bool empty() const { return nodes.empty(); }
+	float power() const { return empty() ? 0.0f : nodes[0].bounds.power; }
+
+	// Lights in the order build() was given them
+	int size() const { return (int)primitives.size(); }
+	const lightPrimitive& primitive(int index) const { return primitives[index]; }
+
+	// Picks a light for a point at p with a single uniform number, remapped at every level.
+	// Returns nullptr if nothing can light p.
+	const lightPrimitive* sample(const glm::vec3& p, float u, float& pmf) const;
+
+	// The light rec hit, and the chance sample() would have picked it from p. Found by what
+	// rec.object is, without tracing anything unless instances of one object overlap there.
+	const lightPrimitive* find(const glm::vec3& p, const hitRecord& rec, float& pmf) const;
+
+private:
+	struct lightNode
+	{
+		lightBounds bounds;
+		int secondChild = -1; // The first child always follows its parent
+		int primitive = -1; // Set for leaves
+	};
+
+	int buildRecursive(std::vector<int>& order, int begin, int end);
+
+	// Chances of going to each child of an interior node from p, false if neither can light it
+	bool childProbabilities(int node, const glm::vec3& p, float& first) const;
+
+	// Index of the light rec hit, -1 if it isn't one
+	int primitiveOf(const hitRecord& rec) const;
+
+	static bool byObjectOrder(const std::pair<const Hittable*, int>& a, const std::pair<const Hittable*, int>& b);
+
+	std::vector<lightNode> nodes;
+	std::vector<lightPrimitive> primitives;
+
+	std::vector<int> leaves; // Each light's leaf node
+	std::vector<std::pair<const Hittable*, int>> byObject; // Lights by the primitive under their transforms
+};
\ No newline at end of file
@@ -0,0 +1,237 @@
+#include "hobbyraytracer.h"
+#include "lights.h"
+
+#include <algorithm>
+
+// Fixed points per light for the power estimate, so a scene always gets the same distribution
+constexpr int POWER_ESTIMATE_SAMPLES = 16;
+
+// Where shadow rays start along their direction, so they stop this far short of the light too
+constexpr float SHADOW_EPSILON = 0.001f;
+
+void LightList::add(std::shared_ptr<Hittable> object, std::shared_ptr<Material> material)
+{
+	float a = object->area();
+	if (a <= 0.0f)
+	{
+		unsampleable.push_back(material);
+		return;
+	}
+
+	std::vector<std::shared_ptr<Hittable>> parts = object->split();
+
+	if (parts.empty())
+	{
+		pending.push_back({ object, material, a });
+		return;
+	}
+
+	for (const auto& part : parts)
+		add(part, material);
+}
+
+void LightList::setEnvironment(std::shared_ptr<EnvironmentMap> map, float sceneRadius)
+{
+	if (!map || !map->canSample())
+		return;
+
+	environment = map;
+	environmentRadius = sceneRadius;
+}
+
+void LightList::build()
+{
+	pending.erase(std::remove_if(pending.begin(), pending.end(), [this](const lightPrimitive& light) {
+			return std::find(unsampleable.begin(), unsampleable.end(), light.material) != unsampleable.end();
+		}), pending.end());
+
+	float total = 0.0f;
+
+	for (lightPrimitive& light : pending)
+	{
+		IndependentSampler sampler(POWER_ESTIMATE_SAMPLES);
+		float radiance = 0.0f;
+
+		for (int i = 0; i < POWER_ESTIMATE_SAMPLES; i++)
+		{
+			surfaceSample s = light.surface->sampleSurface(sampler);
+			radiance += luminance(light.material->emitted(s.u, s.v, s.p));
+		}
+
+		light.bounds.power = glm::max(radiance / POWER_ESTIMATE_SAMPLES, 0.0f) * light.area;
+		light.surface->boundingBox(light.bounds.bounds);
+
+		if (!light.surface->normalBounds(light.bounds.axis, light.bounds.cosTheta))
+			light.bounds.cosTheta = -1.0f;
+
+		total += light.bounds.power;
+
+		if (std::find(materials.begin(), materials.end(), light.material.get()) == materials.end())
+			materials.push_back(light.material.get());
+	}
+
+	// Hits on every piece are left to light sampling, so none can have no chance at all, even
+	// if its estimate came out black (e.g. a textured light). With nothing measurably bright,
+	// pick by area.
+	float minimumPower = pending.empty() ? 0.0f : 1e-3f * total / pending.size();
+
+	for (lightPrimitive& light : pending)
+	{
+		light.bounds.power = total > 0.0f ? glm::max(light.bounds.power, minimumPower) : light.area;
+	}
+
+	bvh.build(std::move(pending));
+	pending.clear();
+
+	emissionCdf.clear();
+	float cumulative = 0.0f;
+
+	for (int i = 0; i < bvh.size(); i++)
+	{
+		cumulative += bvh.primitive(i).bounds.power;
+		emissionCdf.push_back(cumulative);
+	}
+
+	// What falls on a disc the size of the scene, in the same units as radiance times area
+	if (environment)
+	{
+		float environmentPower = environment->totalLuminance() * environmentRadius * environmentRadius;
+		float lightPower = bvh.power();
+
+		environmentSelectionPdf = lightPower > 0.0f ? environmentPower / (environmentPower + lightPower) : 1.0f;
+	}
+}
+
+bool LightList::sample(const glm::vec3& origin, Sampler& sampler, lightSample& sample) const
+{
+	if (empty())
+		return false;
+
+	float u = sampler.nextFloat();
+
+	if (u < environmentSelectionPdf)
+	{
+		float directionPdf;
+		glm::vec3 direction = environment->sampleDirection(sampler, directionPdf);
+		glm::vec2 uv = EnvironmentMap::directionToUV(direction);
+
+		sample.p = origin + direction;
+		sample.normal = -direction;
+		sample.Le = environment->colourValue(uv.x, uv.y, glm::vec3(0));
+		sample.direction = direction;
+		sample.tMax = INFINITY;
+		sample.pdf = environmentSelectionPdf * directionPdf;
+		sample.emissionPdf = 0.0f;
+
+		return sample.pdf > 0.0f;
+	}
+
+	// Reuse what's left of u to walk down the BVH
+	u = glm::min((u - environmentSelectionPdf) / (1.0f - environmentSelectionPdf), 0x1.fffffep-1f);
+
+	float pmf;
+	const lightPrimitive* light = bvh.sample(origin, u, pmf);
+
+	if (!light)
+		return false;
+
+	surfaceSample s = light->surface->sampleSurface(sampler);
+
+	glm::vec3 toLight = s.p - origin;
+	float distanceSquared = glm::dot(toLight, toLight);
+	float distance = glm::sqrt(distanceSquared);
+	float cosine = glm::abs(glm::dot(s.normal, toLight)) / distance;
+
+	if (cosine < 1e-6f || distanceSquared < 1e-12f)
+		return false;
+
+	sample.p = s.p;
+	sample.normal = s.normal;
+	sample.Le = light->material->emitted(s.u, s.v, s.p);
+	sample.direction = toLight / distance;
+	sample.tMax = distance - SHADOW_EPSILON;
+	sample.pdf = (1.0f - environmentSelectionPdf) * pmf * distanceSquared / (light->area * cosine);
+	sample.emissionPdf = emissionPdf(*light);
+
+	return sample.pdf > 0.0f;
+}
+
+float LightList::pdf(const glm::vec3& origin, const hitRecord& rec) const
+{
+	if (!contains(rec.matPtr.get()))
+		return 0.0f;
+
+	float pmf;
+	const lightPrimitive* light = bvh.find(origin, rec, pmf);
+
+	if (!light)
+		return 0.0f;
+
+	glm::vec3 toLight = rec.p - origin;
+	float distanceSquared = glm::dot(toLight, toLight);
+	float cosine = glm::abs(glm::dot(glm::normalize(rec.normal), toLight)) / glm::sqrt(distanceSquared);
+
+	if (cosine < 1e-6f)
+		return 0.0f;
+
+	return (1.0f - environmentSelectionPdf) * pmf * distanceSquared / (light->area * cosine);
+}
+
+float LightList::emissionPdf(const glm::vec3& origin, const hitRecord& rec) const
+{
+	if (!contains(rec.matPtr.get()))
+		return 0.0f;
+
+	float pmf;
+	const lightPrimitive* light = bvh.find(origin, rec, pmf);
+
+	return light ? emissionPdf(*light) : 0.0f;
+}
+
+float LightList::emissionPdf(const lightPrimitive& light) const
+{
+	if (emissionCdf.empty() || emissionCdf.back() <= 0.0f)
+		return 0.0f;
+
+	return light.bounds.power / (emissionCdf.back() * light.area);
+}
+
+float LightList::environmentPdf(const glm::vec3& direction) const
+{
+	return environment ? environmentSelectionPdf * environment->directionPdf(direction) : 0.0f;
+}
+
+bool LightList::contains(const Material* material) const
+{
+	return std::find(materials.begin(), materials.end(), material) != materials.end();
+}
+
+bool LightList::sampleEmission(Sampler& sampler, emissionSample& sample) const
+{
+	if (emissionCdf.empty() || emissionCdf.back() <= 0.0f)
+		return false;
+
+	float target = sampler.nextFloat() * emissionCdf.back();
+	int index = (int)(std::upper_bound(emissionCdf.begin(), emissionCdf.end(), target) - emissionCdf.begin());
+	index = glm::min(index, (int)emissionCdf.size() - 1);
+
+	const lightPrimitive& light = bvh.primitive(index);
+	float pmf = light.bounds.power / emissionCdf.back();
+
+	surfaceSample s = light.surface->sampleSurface(sampler);
+	glm::vec3 normal = glm::normalize(s.normal);
+
+	if (sampler.nextFloat() < 0.5f)
+		normal = -normal;
+
+	// Le cos / (pmf * 1 / area * 1 / 2 * cos / pi)
+	sample.r = ray(s.p, randomCosineDirection(normal, sampler));
+	sample.power = light.material->emitted(s.u, s.v, s.p) * (2.0f * glm::pi<float>() * light.area / pmf);
+
+	sample.normal = normal;
+	sample.Le = light.material->emitted(s.u, s.v, s.p);
+	sample.positionPdf = pmf / light.area;
+	sample.directionPdf = 0.5f * glm::max(glm::dot(normal, glm::normalize(sample.r.dir)), 0.0f) * glm::one_over_pi<float>();
+
+	return pmf > 0.0f;
+}
\ No newline at end of file
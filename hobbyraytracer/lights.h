@@ -0,0 +1,96 @@
+#pragma once
+
+#include "hittableList.h"
+#include "lightBVH.h"
+#include "material.h"
+#include "texture.h"
+
+// A point on a light, with everything needed to weight a connection to it
+struct lightSample
+{
+	glm::vec3 p;
+	glm::vec3 normal;
+	glm::vec3 Le;
+
+	// Shadow ray from the shading point: a unit direction, with t running to tMax at the light.
+	// That's infinity for the environment, and for everything else the distance to p less the
+	// same 0.001 shadow rays skip past their origin, so blockers right by either end still count.
+	glm::vec3 direction;
+	float tMax;
+
+	// Solid angle density from the shading point, including the chance of picking this light
+	float pdf;
+
+	// Area density sampleEmission() would have started a ray at p with, 0 for the environment
+	float emissionPdf;
+};
+
+// A ray leaving a light, for tracing photons from it
+struct emissionSample
+{
+	ray r;
+
+	// Radiance carried, divided by the density of the origin and direction together
+	glm::vec3 power;
+
+	// The same split up, for integrators that weigh this against other ways of finding the path
+	glm::vec3 normal; // Of the face the ray leaves
+	glm::vec3 Le;
+	float positionPdf; // Area density, including the chance of picking this light
+	float directionPdf; // Solid angle density
+};
+
+// The scene's emitters, split into pieces (e.g. a mesh into triangles) in a light BVH, and the
+// environment map if there is one. A piece is picked by its estimated contribution at the shading
+// point and a point on it uniformly by area. Lights emit from both faces like DiffuseLight does.
+class LightList
+{
+public:
+	void add(std::shared_ptr<Hittable> object, std::shared_ptr<Material> material);
+
+	// Samples directions on the background too. sceneRadius bounds the scene, to estimate how
+	// much of the environment's power reaches it compared to the other lights.
+	void setEnvironment(std::shared_ptr<EnvironmentMap> map, float sceneRadius);
+
+	// Estimates each piece's power and builds the light BVH, call once everything is added
+	void build();
+
+	bool empty() const { return bvh.empty() && !environment; }
+	bool hasEnvironment() const { return environment != nullptr; }
+
+	bool sample(const glm::vec3& origin, Sampler& sampler, lightSample& sample) const;
+
+	// Solid angle density sample() would have picked the hit point rec with
+	float pdf(const glm::vec3& origin, const hitRecord& rec) const;
+
+	// Area density sampleEmission() would have started a ray at the hit point rec with
+	float emissionPdf(const glm::vec3& origin, const hitRecord& rec) const;
+
+	// Solid angle density sample() would have picked an escaping direction with
+	float environmentPdf(const glm::vec3& direction) const;
+
+	// Whether hits on this material are already accounted for by light sampling
+	bool contains(const Material* material) const;
+
+	// A piece picked by power, a point on it by area, a face at random and a cosine weighted
+	// direction from it. The environment doesn't emit.
+	bool sampleEmission(Sampler& sampler, emissionSample& sample) const;
+
+private:
+	float emissionPdf(const lightPrimitive& light) const;
+
+	std::vector<lightPrimitive> pending; // Until build() moves them into the BVH
+
+	// Something with these materials (e.g. under a scale) can't be sampled, so everything with
+	// them is left to BSDF sampling rather than counting some of it twice
+	std::vector<std::shared_ptr<Material>> unsampleable;
+
+	std::vector<const Material*> materials; // Of everything in the BVH
+	LightBVH bvh;
+
+	std::vector<float> emissionCdf; // Over the BVH's lights by power, not normalised
+
+	std::shared_ptr<EnvironmentMap> environment;
+	float environmentRadius = 0.0f;
+	float environmentSelectionPdf = 0.0f; // The rest of the time the BVH is sampled
+};
\ No newline at end of file
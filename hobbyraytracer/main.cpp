@@ -21,122 +21,465 @@
 #include "mesh.h"
 #include "film.h"
 #include "scene.h"
+#include "scheduler.h"
+#include "numa.h"
+#include "telemetry.h"
+#include "checkpoint.h"
+#include "renderer.h"
+#include "distributed.h"
+#include "daemon.h"
+#include "fileWatcher.h"
 
 #include <iostream>
 #include <algorithm>
-#include <numeric>
-#include <execution>
 #include <ranges>
+#include <csignal>
+#include <sstream>
 
-// SYSTEM CONSTANTS 
-constexpr int MAX_DEPTH = 50; // Ray "bounce" depth
+// Set by Ctrl+C (or SIGTERM), the render stops at the next tile and writes out what it has so far
+static std::atomic<bool> interrupted = false;
 
-constexpr int NUM_THREADS = 12;
+static void onInterrupt(int sig)
+{
+	interrupted = true;
+
+	// A second signal kills the process as usual
+	std::signal(sig, SIG_DFL);
+}
+
+// Settings from the command line
+struct render_options
+{
+	int threads = 0;
+	uint64_t seed = 0;
+
+	bool numa = false;
+	bool deterministic = false;
+
+	TelemetryOutput telemetry = TelemetryOutput::Console;
+	std::string telemetrySocket;
+
+	std::string checkpoint; // Where to save the render state, empty = never
+	float checkpointInterval = 300.0f; // Seconds between checkpoints
+	bool resumed = false; // The film was restored from a checkpoint
 
-// RENDER
+	std::string coordinator; // Address to hand out work on, empty = render locally
+	std::string worker; // Address of a coordinator to render for
+	std::string daemon; // Address to take render jobs on, keeping the scene loaded
 
-static glm::vec3 rayColour(ray r, const std::shared_ptr<Texture> background, const std::shared_ptr<Hittable> world)
-{	
-	glm::vec3 currentAttenuation = glm::vec3(1.0f);
-	glm::vec3 result = glm::vec3(0.0f);
+	bool batch = false; // Render every camera in the scene's cameras and camera_path
+	bool watch = false; // Render again whenever the scene file changes
+};
 
-	for (int i = 0; i < MAX_DEPTH; ++i) {
-		hitRecord rec;
-		if (!world->hit(r, 0.001f, INFINITY, rec))
+static RenderContext createContext(Scene& scene)
+{
+	return { scene.getBackground(), scene.getScene(), scene.getLights(), scene.getIntegrator(), scene.getSampler(), scene.getCamera() };
+}
+
+static void writeCheckpoint(std::string path, uint64_t seed, film_state state)
+{
+	if (Checkpoint::write(path, { seed, std::move(state) }))
+		std::cout << std::endl << "Checkpoint saved: " << path << std::endl;
+}
+
+static void render(const render_options& options, const std::vector<RenderContext>& replicas, 
+	const NumaTopology* topology, std::shared_ptr<Film>& film)
+{
+	const film_desc f = film->getFilm();
+
+	// Integrators that splat (e.g. bidirectional path tracing) write straight into this film
+	std::vector<RenderContext> contexts = replicas;
+	for (RenderContext& ctx : contexts)
+		ctx.film = film.get();
+
+	int numPixels = f.dimensions.x * f.dimensions.y;
+
+	std::function<void(int worker)> pinWorker;
+
+	if (topology)
+	{
+		pinWorker = [topology](int worker) {
+			NumaTopology::pinCurrentThread({ topology->workerCpu(worker) });
+		};
+	}
+
+	// Workers are pinned once here and reused for every pass
+	TileScheduler scheduler(f.dimensions, f.tileSize, options.threads, pinWorker);
+
+	std::cout << "Rendering " << scheduler.getTiles().size() << " tiles on " 
+		<< scheduler.getNumThreads() << " threads" << std::endl;
+
+	// The film was filled in by whichever thread made or resumed it, move it next to the workers
+	// that will merge into each tile
+	if (topology)
+		film->firstTouch(scheduler);
+
+	// A resumed film already holds some of the samples
+	uint64_t samplesTaken = 0;
+	for (int row = 0; row < f.dimensions.y; row++)
+	{
+		for (int col = 0; col < f.dimensions.x; col++)
 		{
-			// Normalize ray direction
-			glm::vec3 nD = glm::normalize(r.dir);
+			samplesTaken += glm::min(film->getSampleCount({ col, row }), f.samples);
+		}
+	}
+
+	Telemetry telemetry(scheduler.getNumThreads(), (uint64_t)numPixels * f.samples - samplesTaken, 
+		options.telemetry, options.telemetrySocket);
+
+	telemetry.start();
+
+	auto renderStart = std::chrono::high_resolution_clock::now();
+
+	// In progressive mode, or with a time limit, the image is rendered in passes over the whole
+	// frame, so stopping at any point leaves every pixel with roughly the same number of samples.
+	// Checkpoints are only taken between passes, so they need passes too, as do adaptive
+	// sampling, which decides which pixels carry on after each one, and integrators that learn
+	// or change between passes.
+	bool timeLimited = f.timeLimit > 0.0f;
+	bool checkpointing = !options.checkpoint.empty();
+	bool integratorPasses = replicas[0].integrator->needsPasses();
+	bool progressive = f.progressive || timeLimited || checkpointing || options.resumed || f.adaptive || integratorPasses;
+	int samplesPerPass = progressive ? glm::max(f.samplesPerPass, 1) : f.samples;
+
+	auto deadline = renderStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+		std::chrono::duration<float>(f.timeLimit));
+
+	if (timeLimited)
+	{
+		telemetry.setDeadline(deadline);
+		std::cout << "Time limit: " << f.timeLimit << "s" << std::endl;
+	}
+
+	if (progressive)
+	{
+		std::cout << "Progressive: " << samplesPerPass << " samples per pass" << std::endl;
+	}
+
+	if (f.adaptive)
+	{
+		std::cout << "Adaptive: relative error " << f.adaptiveThreshold << " after " << f.minSamples << " samples" << std::endl;
+	}
+
+	std::atomic<bool> outOfTime = false;
+
+	// One sampler per worker for the whole render, made on the worker itself the first time it
+	// takes a tile
+	std::vector<std::unique_ptr<Sampler>> samplers(scheduler.getNumThreads());
+
+	auto lastFlush = renderStart;
+	std::future<int> flushing;
 
-			// Convert normalized ray direction to polar coordinates
-			float phi = atan2(nD.z, nD.x);
-			float theta = acos(nD.y);
+	auto lastCheckpoint = renderStart;
+	std::future<void> saving;
 
-			// Convert polar coordinates to UV coordinates
-			float u = phi / (2 * glm::pi<float>()) + 0.5;
-			float v = theta / glm::pi<float>();
+	int active = film->getActivePixels();
+
+	for (int pass = 1; active > 0 && !outOfTime && !interrupted; pass++)
+	{
+		// Numbered by the samples the furthest pixels have, so a resumed render carries on from the
+		// pass it stopped at
+		if (integratorPasses)
+		{
+			glm::ivec2 range;
+			film->getSampleStatistics(range);
+			int index = range.y / samplesPerPass;
 
-			result += currentAttenuation * background->colourValue(u, v, glm::vec3(0));
-			break;
+			// Replicas share one integrator, so it only traces anything once
+			contexts[0].integrator->beginPass(contexts[0], index, hashCombine(options.seed, index));
 		}
 
-		ray scattered;
-		glm::vec3 attenuation;
-		glm::vec3 emitted = rec.matPtr->emitted(rec.u, rec.v, rec.p);
+		scheduler.run([&](int worker, const Tile& tile) {
+				if (interrupted || (timeLimited && (outOfTime || std::chrono::high_resolution_clock::now() >= deadline)))
+				{
+					outOfTime = !interrupted;
+					return;
+				}
+
+				const RenderContext& ctx = contexts[topology ? topology->workerNode(worker) : 0];
+
+				// Allocated here so the tile buffer is first touched on the worker's own node
+				FilmTile filmTile = film->getFilmTile(tile);
+
+				std::unique_ptr<Sampler>& sampler = samplers[worker];
+				if (!sampler)
+					sampler = Sampler::create(ctx.sampler, f.dimensions, options.seed);
+
+				RayStats stats;
+
+				for (int row = tile.min.y; row < tile.max.y; row++)
+				{
+					auto rowStart = std::chrono::high_resolution_clock::now();
+					uint64_t rowSamples = 0;
+
+					for (int col = tile.min.x; col < tile.max.x; col++)
+					{
+						// Only this tile writes these pixels, so their error can be read mid pass
+						if (film->isConverged({ col, row }))
+							continue;
+
+						// Carry on from wherever this pixel got to. Whole tiles are merged at a time, so
+						// this is always a multiple of the pass size and a resumed render adds up its
+						// samples in exactly the same groups as one that was never stopped.
+						int firstSample = film->getSampleCount({ col, row });
+						int passSamples = glm::min(samplesPerPass, f.samples - firstSample);
 
-		bool b = rec.matPtr->scatter(r, rec, attenuation, scattered);
-		if (!b)
+						rowSamples += glm::max(passSamples, 0);
+
+						renderPixel(ctx, f.dimensions, *sampler, { col, row }, firstSample, passSamples, filmTile, stats);
+					}
+
+					telemetry.flush(worker, stats, rowSamples, std::chrono::high_resolution_clock::now() - rowStart);
+				}
+
+				film->mergeFilmTile(filmTile);
+			}
+		);
+
+		active = film->getActivePixels();
+
+		// The shared integrator has learnt from every node's workers
+		if (integratorPasses)
+		{
+			glm::ivec2 range;
+			float mean = film->getSampleStatistics(range);
+
+			contexts[0].integrator->endPass(mean);
+		}
+
+		// Passes only touch the film from inside scheduler.run, so it's safe to develop it here.
+		// Encoding happens in the background while the next pass renders.
+		auto now = std::chrono::high_resolution_clock::now();
+		bool flushDue = (f.flushPasses > 0 && pass % f.flushPasses == 0)
+			|| (f.flushSeconds > 0.0f && std::chrono::duration<float>(now - lastFlush).count() >= f.flushSeconds);
+
+		if (progressive && flushDue && active > 0)
+		{
+			if (flushing.valid()) flushing.wait();
+
+			flushing = film->outputFilmAsync();
+			lastFlush = now;
+		}
+
+		// Likewise the state is copied here and written out while the next pass renders
+		bool checkpointDue = std::chrono::duration<float>(now - lastCheckpoint).count() >= options.checkpointInterval;
+
+		if (checkpointing && checkpointDue && active > 0 && !interrupted)
 		{
-			result += currentAttenuation * emitted;
-			break;
+			if (saving.valid()) saving.wait();
+
+			saving = std::async(std::launch::async, &writeCheckpoint, options.checkpoint, options.seed, film->getState());
+			lastCheckpoint = now;
 		}
+	}
+
+	if (flushing.valid()) flushing.wait();
+	if (saving.valid()) saving.wait();
+
+	// Always leave a final checkpoint, so a stopped render can be resumed, or a finished one
+	// taken further by raising its sample count
+	if (checkpointing)
+		writeCheckpoint(options.checkpoint, options.seed, film->getState());
+
+	auto renderEnd = std::chrono::high_resolution_clock::now();
+
+	telemetry.stop();
+
+	if (progressive || interrupted)
+	{
+		glm::ivec2 range;
+		float mean = film->getSampleStatistics(range);
+
+		std::cout << (outOfTime ? "Time limit reached" : interrupted ? "Interrupted" : "Sample count reached") << ", samples per pixel: min "
+			<< range.x << ", max " << range.y << ", mean " << std::setprecision(4) << mean << std::endl;
+
+		if (f.adaptive)
+		{
+			int converged = 0;
+			for (int row = 0; row < f.dimensions.y; row++)
+			{
+				for (int col = 0; col < f.dimensions.x; col++)
+				{
+					converged += film->isConverged({ col, row });
+				}
+			}
 
-		result += currentAttenuation * emitted;
-		currentAttenuation *= attenuation;
-		r = scattered;
+			std::cout << "Adaptive: " << converged << " of " << numPixels << " pixels converged early, "
+				<< std::setprecision(3) << 100.0f * mean / f.samples << "% of the sample budget used" << std::endl;
+		}
 	}
 
-	return result;
+	if (topology)
+	{
+		float seconds = std::chrono::duration<float>(renderEnd - renderStart).count();
+
+		std::vector<uint64_t> nodeSamples(topology->numNodes(), 0);
+		std::vector<int> nodeThreads(topology->numNodes(), 0);
+
+		for (int w = 0; w < scheduler.getNumThreads(); w++)
+		{
+			nodeSamples[topology->workerNode(w)] += telemetry.getCounters(w).samples;
+			nodeThreads[topology->workerNode(w)]++;
+		}
+
+		for (int node = 0; node < topology->numNodes(); node++)
+		{
+			std::cout << "NUMA node " << node << ": " << nodeThreads[node] << " threads, " 
+				<< nodeSamples[node] << " samples, " << std::setprecision(4) 
+				<< (nodeSamples[node] / glm::max(seconds, 1e-3f)) / 1e6f << " Msamples/s" << std::endl;
+		}
+	}
 }
 
-static void render(int nThreads, const std::shared_ptr<Texture> background, 
-	const std::shared_ptr<Hittable> world, const Camera& camera, std::shared_ptr<Film>& film)
+// "out/render.png" -> "out/render_0007.png"
+static std::string numberedOutput(const std::string& output, int frame)
 {
-	const film_desc f = film->getFilm();
+	std::filesystem::path path(output);
 
-	std::atomic<int> scanlinesCompleted = 0;
+	std::stringstream name;
+	name << path.stem().string() << "_" << std::setw(4) << std::setfill('0') << frame << path.extension().string();
 
-	int numPixels = f.dimensions.x * f.dimensions.y;
+	return (path.parent_path() / name.str()).string();
+}
 
-	std::mutex m;
+// Render each camera into its own numbered image, reusing the loaded scene. Each image is
+// encoded and written on another thread while the next one renders.
+static int renderBatch(const render_options& options, Scene& scene, const std::vector<RenderContext>& replicas,
+	const NumaTopology* topology)
+{
+	std::shared_ptr<Film> base = scene.getFilm();
 
-	std::vector<int> indices(numPixels);
-	std::iota(indices.begin(), indices.end(), 0);
+	std::vector<Camera> cameras;
+	try {
+		cameras = scene.createBatchCameras(base->getAspectRatio());
+	}
+	catch (const YAML::Exception& ex) {
+		std::cout << ex.what() << std::endl;
+		return -1;
+	}
+
+	if (cameras.empty())
+	{
+		std::cout << "Nothing to batch render, the scene has no cameras or camera_path" << std::endl;
+		return -1;
+	}
 
-	std::atomic<int> pixelsCompleted = 0;
+	// Checkpoints describe a single film
+	render_options frameOptions = options;
+	frameOptions.checkpoint.clear();
+	frameOptions.resumed = false;
 
-	std::thread reporter([&pixelsCompleted](int totalPixels) {
-			while (pixelsCompleted <= totalPixels)
-			{
-				std::cout << "\rPixels rendered: " << pixelsCompleted << "/" << totalPixels << std::flush;
-				
-				if (pixelsCompleted == totalPixels)
-					break;
+	std::future<int> writing;
 
-				std::this_thread::sleep_for(std::chrono::milliseconds(500));
-			}
-		},
-		numPixels
-	);
+	for (int frame = 0; frame < (int)cameras.size() && !interrupted; frame++)
+	{
+		YAML::Node overrides;
+		overrides["output"] = numberedOutput(base->getOutputName(), frame);
 
-	std::for_each_n(std::execution::par, indices.begin(), numPixels,
-		[&](int pIdx) {
-			glm::vec3 pixelColour(0.0f);
+		std::shared_ptr<Film> film = scene.createFilm(overrides);
+		film->setDeterministic(options.deterministic);
 
-			int x = pIdx % f.dimensions.x;
-			int y = f.dimensions.y - pIdx / f.dimensions.x;
+		std::vector<RenderContext> contexts = replicas;
+		for (RenderContext& ctx : contexts)
+		{
+			ctx.camera = cameras[frame];
+		}
 
-			for (size_t s = 0; s < f.samples; s++)
-			{
-				float u = ((float)x + glm::linearRand(0.0f, 1.0f)) / (f.dimensions.x - 1);
-				float v = ((float)y + glm::linearRand(0.0f, 1.0f)) / (f.dimensions.y - 1);
+		std::cout << "Frame " << frame + 1 << "/" << cameras.size() << ": " << film->getOutputName() << std::endl;
 
-				pixelColour += rayColour(camera.getRay(u, v), background, world);
+		render(frameOptions, contexts, topology, film);
+
+		if (writing.valid()) writing.wait();
+		writing = film->outputFilmAsync();
+	}
+
+	if (writing.valid()) writing.wait();
+
+	return 0;
+}
+
+// Render again every time the scene file changes, rebuilding only what the edit touched
+static void watchScene(const render_options& options, const std::filesystem::path& file,
+	std::vector<std::unique_ptr<Scene>>& scenes, std::vector<RenderContext>& replicas, const NumaTopology* topology)
+{
+	// Checkpoints belong to the first render
+	render_options watchOptions = options;
+	watchOptions.checkpoint.clear();
+	watchOptions.resumed = false;
+
+	// Meshes and textures the scene refers to count as part of it, an edit to one reads just that
+	// file again
+	FileWatcher watcher(file);
+	for (const auto& input : scenes[0]->getInputFiles())
+		watcher.watch(input);
+
+	std::cout << "Watching " << file.string() << " for changes, Ctrl+C to stop" << std::endl;
+
+	while (watcher.wait(interrupted))
+	{
+		auto reloadStart = std::chrono::high_resolution_clock::now();
+
+		// Only swapped in once every replica has loaded, a broken edit leaves the last good scene in place
+		std::vector<std::unique_ptr<Scene>> reloaded;
+
+		for (int node = 0; node < (int)scenes.size(); node++)
+		{
+			auto scene = std::make_unique<Scene>();
+			if (options.deterministic)
+				scene->setDeterministic(options.seed);
+
+			int loaded = 0;
+			auto load = [&]() {
+				loaded = scene->loadScene(file.string(), scenes[node].get());
+
+				if (loaded > 0 && node > 0)
+					scene->shareIntegrator(*reloaded[0]);
+			};
+
+			if (topology)
+			{
+				std::thread loader([&]() {
+					NumaTopology::pinCurrentThread(topology->getCpus(node));
+					load();
+				});
+				loader.join();
 			}
+			else
+			{
+				load();
+			}
+
+			if (loaded < 1)
+				break;
 
-			pixelColour /= static_cast<float>(f.samples);
+			reloaded.push_back(std::move(scene));
+		}
+
+		if (reloaded.size() != scenes.size())
+		{
+			std::cout << "Keeping the previous scene until the next change" << std::endl;
+			continue;
+		}
 
-			film->tonemap(pixelColour);
+		scenes = std::move(reloaded);
 
-			std::lock_guard<std::mutex> guard(m);
-			film->writeColour(pixelColour, film->getPixels() + (pIdx * 3));
+		for (const auto& input : scenes[0]->getInputFiles())
+			watcher.watch(input);
 
-			pixelsCompleted++;
+		for (int node = 0; node < (int)scenes.size(); node++)
+		{
+			replicas[node] = createContext(*scenes[node]);
 		}
-	);
 
-	reporter.join();
+		std::cout << "Reload took " << std::setprecision(4)
+			<< std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - reloadStart).count() << "s" << std::endl;
+
+		std::shared_ptr<Film> film = scenes[0]->getFilm();
+		film->setDeterministic(options.deterministic);
 
-	std::cout << "\n";
+		render(watchOptions, replicas, topology, film);
+		film->outputFilm();
+	}
 }
 
 int main(int argc, char** argv)
@@ -144,22 +487,139 @@ int main(int argc, char** argv)
 	auto start = std::chrono::high_resolution_clock::now();
 
 	std::filesystem::path file = "teapot_scene.yaml";
-	
-	if (argc > 1)
+	render_options options;
+	std::string resumeFrom;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--threads" && i + 1 < argc)
+		{
+			options.threads = std::stoi(argv[++i]);
+		}
+		else if (arg == "--numa")
+		{
+			options.numa = true;
+		}
+		else if (arg == "--deterministic")
+		{
+			options.deterministic = true;
+		}
+		else if (arg == "--seed" && i + 1 < argc)
+		{
+			options.seed = std::stoull(argv[++i]);
+		}
+		else if (arg == "--telemetry" && i + 1 < argc)
+		{
+			options.telemetry = std::string(argv[++i]) == "json" ? TelemetryOutput::Json : TelemetryOutput::Console;
+		}
+		else if (arg == "--telemetry-socket" && i + 1 < argc)
+		{
+			options.telemetrySocket = argv[++i];
+		}
+		else if (arg == "--checkpoint" && i + 1 < argc)
+		{
+			options.checkpoint = argv[++i];
+		}
+		else if (arg == "--checkpoint-interval" && i + 1 < argc)
+		{
+			options.checkpointInterval = std::stof(argv[++i]);
+		}
+		else if (arg == "--resume" && i + 1 < argc)
+		{
+			resumeFrom = argv[++i];
+		}
+		else if (arg == "--coordinator" && i + 1 < argc)
+		{
+			options.coordinator = argv[++i];
+		}
+		else if (arg == "--worker" && i + 1 < argc)
+		{
+			options.worker = argv[++i];
+		}
+		else if (arg == "--daemon" && i + 1 < argc)
+		{
+			options.daemon = argv[++i];
+		}
+		else if (arg == "--batch")
+		{
+			options.batch = true;
+		}
+		else if (arg == "--watch")
+		{
+			options.watch = true;
+		}
+		else
+		{
+			file = arg;
+		}
+	}
+
+	// The seed has to be known before loading, deterministic BVH builds depend on it
+	checkpoint_desc resume;
+	if (!resumeFrom.empty())
 	{
-		file = argv[1];
+		if (!Checkpoint::read(resumeFrom, resume))
+			return -1;
+
+		options.seed = resume.seed;
+		options.resumed = true;
+
+		// Keep saving to the same place unless told otherwise
+		if (options.checkpoint.empty())
+			options.checkpoint = resumeFrom;
 	}
 
-	Scene scene;
+	NumaTopology topology = NumaTopology::detect();
 
-	if (scene.loadScene(file.string()) < 1)
-		return -1;
+	// In NUMA mode the scene is loaded once per node, each time from a thread pinned to that
+	// node, so first touch places every replica's BVH, triangles and textures in local memory.
+	// The integrator is the exception: there's one, so photon maps, path guides and radiance
+	// caches are built once and learn from every node's workers.
+	std::vector<std::unique_ptr<Scene>> scenes;
+	std::vector<RenderContext> replicas;
+
+	for (int node = 0; node < (options.numa ? topology.numNodes() : 1); node++)
+	{
+		auto scene = std::make_unique<Scene>();
+		if (options.deterministic)
+			scene->setDeterministic(options.seed);
+
+		RenderContext ctx;
+		int loaded = 0;
+
+		auto load = [&]() {
+			loaded = scene->loadScene(file.string());
 
-	Camera camera = scene.getCamera();
-	std::shared_ptr<Film> film = scene.getFilm();
-	std::shared_ptr<Texture> background = scene.getBackground();
+			if (loaded > 0 && node > 0)
+				scene->shareIntegrator(*scenes[0]);
 
-	std::shared_ptr<HittableList> world = scene.getScene();
+			if (loaded > 0)
+				ctx = createContext(*scene);
+		};
+
+		if (options.numa)
+		{
+			std::thread loader([&]() {
+				NumaTopology::pinCurrentThread(topology.getCpus(node));
+				load();
+			});
+			loader.join();
+		}
+		else
+		{
+			load();
+		}
+
+		if (loaded < 1)
+			return -1;
+
+		scenes.push_back(std::move(scene));
+		replicas.push_back(ctx);
+	}
+
+	std::shared_ptr<Film> film = scenes[0]->getFilm();
 
 	auto loadedEnd = std::chrono::high_resolution_clock::now();
 
@@ -173,7 +633,87 @@ int main(int argc, char** argv)
 
 	// RENDER
 
-	render(NUM_THREADS, background, world, camera, film);
+	// Command line beats the scene file, which beats the hardware default
+	if (options.threads <= 0) options.threads = film->getFilm().threads;
+	if (options.threads <= 0) options.threads = glm::max<int>(std::thread::hardware_concurrency(), 1);
+
+	if (options.numa)
+	{
+		std::cout << "NUMA mode: " << topology.numNodes() << " node(s), scene replicated per node" << std::endl;
+	}
+
+	// Every sample's generator is seeded from (seed, pixel, sample index), which makes the
+	// image independent of thread count and tile order as long as the seed is fixed
+	if (options.deterministic)
+	{
+		std::cout << "Deterministic mode, seed: " << options.seed << std::endl;
+		film->setDeterministic(true);
+	}
+	else if (!options.resumed)
+	{
+		options.seed = std::random_device{}();
+	}
+
+	if (options.resumed)
+	{
+		if (!film->setState(std::move(resume.film)))
+			return -1;
+
+		glm::ivec2 range;
+		float mean = film->getSampleStatistics(range);
+
+		std::cout << "Resuming from: " << resumeFrom << ", samples per pixel: min " << range.x
+			<< ", max " << range.y << ", mean " << std::setprecision(4) << mean << std::endl;
+	}
+
+	std::signal(SIGINT, onInterrupt);
+	std::signal(SIGTERM, onInterrupt);
+
+	if (options.batch)
+	{
+		return renderBatch(options, *scenes[0], replicas, options.numa ? &topology : nullptr);
+	}
+
+	if (!options.daemon.empty())
+	{
+		// Jobs are one-off renders, they never checkpoint
+		render_options jobOptions = options;
+		jobOptions.checkpoint.clear();
+		jobOptions.resumed = false;
+
+		RenderDaemon daemon(*scenes[0], replicas, [&](const std::vector<RenderContext>& contexts, std::shared_ptr<Film>& jobFilm) {
+			jobFilm->setDeterministic(options.deterministic);
+			render(jobOptions, contexts, options.numa ? &topology : nullptr, jobFilm);
+		});
+
+		return daemon.run(options.daemon, interrupted) ? 0 : -1;
+	}
+
+	// Workers take the seed and their work from the coordinator, and write nothing themselves
+	if (!options.worker.empty())
+	{
+		RenderWorker worker(replicas[0], film->getFilm().dimensions, options.threads);
+		return worker.run(options.worker) ? 0 : -1;
+	}
+
+	if (!options.coordinator.empty())
+	{
+		// Work units are handed out up front, before any pixel's error is known
+		if (film->getFilm().adaptive)
+			std::cout << "WARNING: Adaptive sampling isn't supported when distributing, every pixel gets all its samples" << std::endl;
+
+		// Workers never see the start or end of a pass
+		if (replicas[0].integrator->needsPasses())
+			std::cout << "WARNING: Path guiding, photon mapping and the radiance cache aren't supported when distributing, workers render with plain MIS" << std::endl;
+
+		Coordinator coordinator(film, options.seed);
+		if (!coordinator.run(options.coordinator, interrupted) && !interrupted)
+			return -1;
+	}
+	else
+	{
+		render(options, replicas, options.numa ? &topology : nullptr, film);
+	}
 
 	// OUTPUT IMAGE
 
@@ -191,5 +731,8 @@ int main(int argc, char** argv)
 	std::cout << std::endl << std::setprecision(6) << "Done! (completed in "
 		<< iH << ":" << iM << ":" << fS << ")" << std::endl;
 
+	if (options.watch && !interrupted)
+		watchScene(options, file, scenes, replicas, options.numa ? &topology : nullptr);
+
 	return r;
 }
\ No newline at end of file
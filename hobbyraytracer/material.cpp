@@ -1,6 +1,22 @@
 #include "hobbyraytracer.h"
 #include "material.h"
 
+// GGX normal distribution, cosTheta is between the microfacet normal and the surface normal
+static float ggxD(float cosTheta, float alpha)
+{
+	float a2 = alpha * alpha;
+	float d = cosTheta * cosTheta * (a2 - 1.0f) + 1.0f;
+
+	return a2 / (glm::pi<float>() * d * d);
+}
+
+// Smith shadowing for one direction
+static float smithG1(float cosTheta, float alpha)
+{
+	float a2 = alpha * alpha;
+	return 2.0f * cosTheta / (cosTheta + glm::sqrt(a2 + (1.0f - a2) * cosTheta * cosTheta));
+}
+
 PBR::PBR(glm::vec3 albedo, float metallness, float roughness)
 	: mix(std::make_shared<SolidColourTexture>(metallness))
 {
@@ -15,14 +31,302 @@ PBR::PBR(std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> metallness, f
 	diffuse = std::make_shared<Lambertian>(albedo);
 }
 
-bool PBR::scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const
+const Material& PBR::pick(const hitRecord& rec) const
 {
 	bool m = glm::length(mix->colourValue(rec.u, rec.v, rec.p)) > 0.5f;
 	if (m)
 	{
-		return metal->scatter(r_in, rec, attenuation, scattered);
+		return *metal;
 	}
 
-	return diffuse->scatter(r_in, rec, attenuation, scattered);
+	return *diffuse;
+}
+
+bool PBR::scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const
+{
+	return pick(rec).scatter(r_in, rec, attenuation, scattered, sampler);
+}
+
+bool PBR::isSpecular(const hitRecord& rec) const
+{
+	return pick(rec).isSpecular(rec);
+}
+
+glm::vec3 PBR::eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	return pick(rec).eval(r_in, rec, direction);
+}
+
+float PBR::pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	return pick(rec).pdf(r_in, rec, direction);
+}
+
+BounceType PBR::bounceType(const hitRecord& rec, const glm::vec3& direction) const
+{
+	return pick(rec).bounceType(rec, direction);
+}
+
+float Metal::roughnessAt(const hitRecord& rec) const
+{
+	float roughness = glm::length(r.valueAt(rec.u, rec.v, rec.p));
+	return roughness < 1 ? roughness : 1;
+}
+
+bool Metal::isSpecular(const hitRecord& rec) const
+{
+	return roughnessAt(rec) < MIN_ROUGHNESS;
+}
+
+bool Metal::scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const
+{
+	glm::vec3 n = glm::normalize(rec.normal);
+	glm::vec3 wo = -glm::normalize(r_in.dir);
+	glm::vec3 tint = albedo.valueAt(rec.u, rec.v, rec.p);
+
+	float roughness = roughnessAt(rec);
+
+	if (roughness < MIN_ROUGHNESS)
+	{
+		scattered = ray(rec.p, glm::reflect(-wo, n));
+		attenuation = tint;
+
+		return glm::dot(scattered.dir, n) > 0;
+	}
+
+	// Sample a microfacet normal from D(h) * cos(theta_h) and reflect about it
+	float alpha = roughness * roughness;
+	float u1 = sampler.nextFloat();
+	float phi = 2.0f * glm::pi<float>() * sampler.nextFloat();
+
+	float cosThetaH = glm::sqrt((1.0f - u1) / (1.0f + (alpha * alpha - 1.0f) * u1));
+	float sinThetaH = glm::sqrt(glm::max(0.0f, 1.0f - cosThetaH * cosThetaH));
+
+	glm::vec3 tangent, bitangent;
+	orthonormalBasis(n, tangent, bitangent);
+
+	glm::vec3 h = sinThetaH * glm::cos(phi) * tangent + sinThetaH * glm::sin(phi) * bitangent + cosThetaH * n;
+	float oDotH = glm::dot(wo, h);
+	glm::vec3 wi = 2.0f * oDotH * h - wo;
+
+	float cosO = glm::dot(wo, n);
+	float cosI = glm::dot(wi, n);
+
+	if (cosI <= 0.0f || cosO <= 0.0f || oDotH <= 0.0f)
+		return false;
+
+	// f * cos(theta_i) / pdf, with the D terms cancelling
+	scattered = ray(rec.p, wi);
+	attenuation = tint * (smithG1(cosO, alpha) * smithG1(cosI, alpha) * oDotH / (cosO * cosThetaH));
+
+	return true;
+}
+
+glm::vec3 Metal::eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	glm::vec3 n = glm::normalize(rec.normal);
+	glm::vec3 wo = -glm::normalize(r_in.dir);
+	glm::vec3 wi = glm::normalize(direction);
+
+	float cosO = glm::dot(wo, n);
+	float cosI = glm::dot(wi, n);
+
+	if (cosI <= 0.0f || cosO <= 0.0f)
+		return glm::vec3(0.0f);
+
+	float alpha = roughnessAt(rec) * roughnessAt(rec);
+	glm::vec3 h = glm::normalize(wo + wi);
+
+	float d = ggxD(glm::dot(h, n), alpha);
+	float g = smithG1(cosO, alpha) * smithG1(cosI, alpha);
+
+	return albedo.valueAt(rec.u, rec.v, rec.p) * (d * g / (4.0f * cosO));
+}
+
+float Metal::pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	glm::vec3 n = glm::normalize(rec.normal);
+	glm::vec3 wo = -glm::normalize(r_in.dir);
+	glm::vec3 wi = glm::normalize(direction);
+
+	if (glm::dot(wi, n) <= 0.0f)
+		return 0.0f;
+
+	float alpha = roughnessAt(rec) * roughnessAt(rec);
+	glm::vec3 h = glm::normalize(wo + wi);
+	float oDotH = glm::dot(wo, h);
+
+	if (oDotH <= 0.0f)
+		return 0.0f;
+
+	return ggxD(glm::dot(h, n), alpha) * glm::dot(h, n) / (4.0f * oDotH);
+}
+
+float Dielectric::roughnessAt(const hitRecord& rec) const
+{
+	float roughness = r.valueAt(rec.u, rec.v, rec.p);
+	return glm::clamp(roughness, 0.0f, 1.0f);
+}
+
+float Dielectric::refractionRatio(const hitRecord& rec) const
+{
+	return rec.frontFace ? (1.0f / ir.valueAt(rec.u, rec.v, rec.p)) : ir.valueAt(rec.u, rec.v, rec.p);
+}
+
+bool Dielectric::isSpecular(const hitRecord& rec) const
+{
+	return roughnessAt(rec) < MIN_ROUGHNESS;
+}
+
+bool Dielectric::scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const
+{
+	attenuation = glm::vec3(1, 1, 1);
+	float ratio = refractionRatio(rec);
+	float roughness = roughnessAt(rec);
+
+	if (roughness < MIN_ROUGHNESS)
+	{
+		glm::vec3 unitDirection = glm::normalize(r_in.dir);
+		double cosTheta = glm::min(glm::dot(-unitDirection, rec.normal), 1.0f);
+		double sinTheta = glm::sqrt(1.0 - cosTheta * cosTheta);
+
+		bool cannot_refract = ratio * sinTheta > 1.0;
+		glm::vec3 direction;
+
+		double ref = reflectance(cosTheta, ratio);
+
+		if (cannot_refract || ref > sampler.nextFloat())
+		{
+			direction = reflect(unitDirection, rec.normal);
+		}
+		else
+		{
+			direction = glm::refract(unitDirection, rec.normal, ratio);
+		}
+
+		scattered = ray(rec.p, direction + roughness * randomUnitVector(sampler));
+		return true;
+	}
+
+	glm::vec3 n = glm::normalize(rec.normal);
+	glm::vec3 wo = -glm::normalize(r_in.dir);
+	float cosO = glm::dot(wo, n);
+
+	// Sample a microfacet normal from D(h) * cos(theta_h), as Metal does
+	float alpha = roughness * roughness;
+	float u1 = sampler.nextFloat();
+	float phi = 2.0f * glm::pi<float>() * sampler.nextFloat();
+
+	float cosThetaH = glm::sqrt((1.0f - u1) / (1.0f + (alpha * alpha - 1.0f) * u1));
+	float sinThetaH = glm::sqrt(glm::max(0.0f, 1.0f - cosThetaH * cosThetaH));
+
+	glm::vec3 tangent, bitangent;
+	orthonormalBasis(n, tangent, bitangent);
+
+	glm::vec3 h = sinThetaH * glm::cos(phi) * tangent + sinThetaH * glm::sin(phi) * bitangent + cosThetaH * n;
+	float oDotH = glm::dot(wo, h);
+
+	if (cosO <= 0.0f || oDotH <= 0.0f)
+		return false;
+
+	// Fresnel against the microfacet, all of it reflected past the critical angle
+	float sinThetaO = glm::sqrt(glm::max(0.0f, 1.0f - oDotH * oDotH));
+	float fresnel = ratio * sinThetaO > 1.0f ? 1.0f : (float)reflectance(oDotH, ratio);
+
+	glm::vec3 wi = fresnel > sampler.nextFloat()
+		? 2.0f * oDotH * h - wo
+		: glm::refract(-wo, h, ratio);
+
+	float cosI = glm::dot(wi, n);
+	float iDotH = glm::dot(wi, h);
+
+	// Either side, wi has to leave the microfacet on the same side as the surface
+	if (cosI == 0.0f || (cosI > 0.0f) != (iDotH > 0.0f))
+		return false;
+
+	// f * |cos(theta_i)| / pdf is the same for both lobes, with D, the Fresnel choice and the
+	// half vector Jacobians cancelling
+	scattered = ray(rec.p, wi);
+	attenuation = glm::vec3(smithG1(cosO, alpha) * smithG1(glm::abs(cosI), alpha) * oDotH / (cosO * cosThetaH));
+
+	return true;
+}
+
+bool Dielectric::halfVector(const ray& r_in, const hitRecord& rec, const glm::vec3& direction, microfacetPair& m) const
+{
+	glm::vec3 n = glm::normalize(rec.normal);
+	glm::vec3 wo = -glm::normalize(r_in.dir);
+	glm::vec3 wi = glm::normalize(direction);
+
+	m.cosO = glm::dot(wo, n);
+	m.cosI = glm::dot(wi, n);
+	m.ratio = refractionRatio(rec);
+
+	if (m.cosO == 0.0f || m.cosI == 0.0f)
+		return false;
+
+	// Paths are also evaluated backwards (BDPT's reverse densities), from the far side of the
+	// surface to the side rec was hit from, so work from whichever side wo is on
+	if (m.cosO < 0.0f)
+	{
+		n = -n;
+		m.cosO = -m.cosO;
+		m.cosI = -m.cosI;
+		m.ratio = 1.0f / m.ratio;
+	}
+
+	m.reflected = m.cosI > 0.0f;
+	m.alpha = roughnessAt(rec) * roughnessAt(rec);
+
+	// Generalised for refraction (eta_i * wi + eta_o * wo) and turned to face n
+	glm::vec3 h = m.reflected ? glm::normalize(wo + wi) : glm::normalize(wi / m.ratio + wo);
+	if (glm::dot(h, n) < 0.0f)
+		h = -h;
+
+	m.cosH = glm::dot(h, n);
+	m.oDotH = glm::dot(wo, h);
+	m.iDotH = glm::dot(wi, h);
+
+	if (m.oDotH <= 0.0f || m.reflected != (m.iDotH > 0.0f))
+		return false;
+
+	float sinThetaO = glm::sqrt(glm::max(0.0f, 1.0f - m.oDotH * m.oDotH));
+	m.fresnel = m.ratio * sinThetaO > 1.0f ? 1.0f : (float)reflectance(m.oDotH, m.ratio);
+
+	return true;
+}
+
+glm::vec3 Dielectric::eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	microfacetPair m;
+	if (!halfVector(r_in, rec, direction, m))
+		return glm::vec3(0.0f);
+
+	float d = ggxD(m.cosH, m.alpha);
+	float g = smithG1(m.cosO, m.alpha) * smithG1(glm::abs(m.cosI), m.alpha);
+
+	if (m.reflected)
+		return glm::vec3(m.fresnel * d * g / (4.0f * m.cosO));
+
+	float denominator = m.iDotH + m.oDotH * m.ratio;
+	denominator *= denominator;
+
+	return glm::vec3((1.0f - m.fresnel) * d * g * glm::abs(m.iDotH) * m.oDotH / (m.cosO * denominator));
+}
+
+float Dielectric::pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+{
+	microfacetPair m;
+	if (!halfVector(r_in, rec, direction, m))
+		return 0.0f;
+
+	float hPdf = ggxD(m.cosH, m.alpha) * m.cosH;
+
+	if (m.reflected)
+		return m.fresnel * hPdf / (4.0f * m.oDotH);
+
+	float denominator = m.iDotH + m.oDotH * m.ratio;
+	denominator *= denominator;
 
+	return (1.0f - m.fresnel) * hPdf * glm::abs(m.iDotH) / denominator;
 }
\ No newline at end of file
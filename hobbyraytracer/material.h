@@ -4,9 +4,28 @@
 
 #include "texture.h"
 #include "hittable.h"
+#include "sampler.h"
 
 struct hitRecord;
 
+// Which of the integrator's depth limits a bounce counts against
+enum class BounceType
+{
+	Diffuse,
+	Glossy, // Any reflection off metal or glass, rough or mirror
+	Transmission // Through a surface
+};
+
+// A direction drawn from a material's BSDF
+struct bsdfSample
+{
+	glm::vec3 direction;
+	glm::vec3 weight; // BSDF * cosine / pdf, what scatter() calls the attenuation
+
+	float pdf; // Solid angle density, 0 for a specular (delta) direction
+	BounceType type;
+};
+
 class MatVec3
 {
 public:
@@ -61,29 +80,87 @@ class Material
 {
 public:
 	virtual bool scatter(
-		const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered
+		const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler
 	) const = 0;
 
 	virtual glm::vec3 emitted(float u, float v, const glm::vec3& p) const
 	{
 		return glm::vec3(0, 0, 0);
 	}
+
+	// Whether surfaces with this material should be sampled as lights
+	virtual bool isEmissive() const { return false; }
+
+	// True where the BSDF is a delta (a mirror or smooth glass), so only the scattered ray can find
+	// what lights the point and it is never connected to a light sample. Materials that return false
+	// must give eval() and pdf() that agree with the directions scatter() draws. Those that only have
+	// scatter() keep this default.
+	virtual bool isSpecular(const hitRecord& rec) const { return true; }
+
+	// BSDF times the cosine term, for light arriving along direction (pointing away from the
+	// surface). Only meaningful when isSpecular() is false.
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+	{
+		return glm::vec3(0, 0, 0);
+	}
+
+	// Solid angle density scatter() draws direction with. Only meaningful when isSpecular() is false.
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const
+	{
+		return 0.0f;
+	}
+
+	// What kind of bounce scattering along direction is
+	virtual BounceType bounceType(const hitRecord& rec, const glm::vec3& direction) const { return BounceType::Diffuse; }
+
+	// scatter() along with the density of the direction it drew, for weighting it against light sampling
+	virtual bool sample(const ray& r_in, const hitRecord& rec, Sampler& sampler, bsdfSample& s) const
+	{
+		ray scattered;
+		if (!scatter(r_in, rec, s.weight, scattered, sampler))
+			return false;
+
+		s.direction = scattered.dir;
+		s.pdf = isSpecular(rec) ? 0.0f : pdf(r_in, rec, s.direction);
+		s.type = bounceType(rec, s.direction);
+
+		return true;
+	}
 };
 
+// Cosine weighted lobe shared by the diffuse materials, matching the normal + randomUnitVector
+// directions their scatter() draws
+inline float lambertCosine(const hitRecord& rec, const glm::vec3& direction)
+{
+	return glm::max(glm::dot(glm::normalize(rec.normal), glm::normalize(direction)), 0.0f) * glm::one_over_pi<float>();
+}
+
 class Isotropic : public Material
 {
 public:
 	Isotropic(glm::vec3 c) : albedo(std::make_shared<SolidColourTexture>(c)) { }
 	Isotropic(std::shared_ptr<Texture> a) : albedo(a) { }
 
-	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
+	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override
 	{
-		scattered = ray(rec.p, glm::ballRand(1.0f));
+		scattered = ray(rec.p, randomInUnitBall(sampler));
 		attenuation = albedo->colourValue(rec.u, rec.v, rec.p);
 
 		return true;
 	}
 
+	virtual bool isSpecular(const hitRecord& rec) const override { return false; }
+
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return albedo->colourValue(rec.u, rec.v, rec.p) * (0.25f * glm::one_over_pi<float>());
+	}
+
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return 0.25f * glm::one_over_pi<float>();
+	}
+
 private:
 	std::shared_ptr<Texture> albedo;
 };
@@ -93,7 +170,7 @@ class DiffuseLight : public Material
 public:
 	DiffuseLight(MatVec3 colour, MatScalar strength) : emit(colour), s(strength) { }
 
-	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
+	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override
 	{
 		return false;
 	}
@@ -103,6 +180,8 @@ public:
 		return emit.valueAt(u, v, p) * s.valueAt(u, v, p);
 	}
 
+	virtual bool isEmissive() const override { return true; }
+
 private:
 	MatVec3 emit;
 	MatScalar s;
@@ -113,9 +192,9 @@ class UVTest : public Material
 public:
 	UVTest() { }
 
-	bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
+	bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override
 	{
-		glm::vec3 scatterDirection = rec.normal + glm::sphericalRand(1.0f);
+		glm::vec3 scatterDirection = rec.normal + randomUnitVector(sampler);
 
 		if (nearZero(scatterDirection))
 		{
@@ -127,6 +206,18 @@ public:
 
 		return true;
 	}
+
+	virtual bool isSpecular(const hitRecord& rec) const override { return false; }
+
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return rec.normal * lambertCosine(rec, direction);
+	}
+
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return lambertCosine(rec, direction);
+	}
 };
 
 class Lambertian : public Material
@@ -134,9 +225,9 @@ class Lambertian : public Material
 public:
 	Lambertian(MatVec3 a) : albedo(a) { }
 
-	bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
+	bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override
 	{
-		glm::vec3 scatterDirection = rec.normal + glm::sphericalRand(1.0f);
+		glm::vec3 scatterDirection = rec.normal + randomUnitVector(sampler);
 
 		if (nearZero(scatterDirection))
 		{
@@ -152,10 +243,24 @@ public:
 		return true;
 	}
 
+	virtual bool isSpecular(const hitRecord& rec) const override { return false; }
+
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return albedo.valueAt(rec.u, rec.v, rec.p) * lambertCosine(rec, direction);
+	}
+
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override
+	{
+		return lambertCosine(rec, direction);
+	}
+
 private:
 	MatVec3 albedo;
 };
 
+// GGX microfacet conductor tinted by albedo at every angle, with alpha = roughness^2. Below
+// MIN_ROUGHNESS it is a perfect mirror reflecting albedo, as metal always has been.
 class Metal : public Material
 {
 public:
@@ -163,20 +268,19 @@ public:
 		albedo(colour),
 		r(roughness) { }
 
-	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
-	{
-		glm::vec3 reflected = glm::reflect(glm::normalize(r_in.dir), glm::normalize(rec.normal));
-
-		float roughness = glm::length(r.valueAt(rec.u, rec.v, rec.p));
-		roughness = roughness < 1 ? roughness : 1;
+	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override;
 
-		scattered = ray(rec.p, reflected + roughness * glm::sphericalRand(1.0f) + glm::vec3(std::numeric_limits<float>::epsilon()));
-		attenuation = albedo.valueAt(rec.u, rec.v, rec.p);
+	virtual bool isSpecular(const hitRecord& rec) const override;
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
 
-		return glm::dot(scattered.dir, glm::normalize(rec.normal)) > 0;
-	}
+	virtual BounceType bounceType(const hitRecord& rec, const glm::vec3& direction) const override { return BounceType::Glossy; }
 
 private:
+	static constexpr float MIN_ROUGHNESS = 0.01f;
+
+	float roughnessAt(const hitRecord& rec) const;
+
 	MatVec3 albedo;
 	MatScalar r;
 };
@@ -187,48 +291,66 @@ public:
 	PBR(glm::vec3 albedo, float metallness, float roughness);
 	PBR(std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> metallness, float roughness);
 
-	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override;
+	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override;
+
+	virtual bool isSpecular(const hitRecord& rec) const override;
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
+	virtual BounceType bounceType(const hitRecord& rec, const glm::vec3& direction) const override;
 
 private:
+	// The metal/diffuse choice is a threshold on the mix texture, so it is the same for every
+	// scatter, eval and isSpecular call at one point
+	const Material& pick(const hitRecord& rec) const;
+
 	std::shared_ptr<Metal> metal;
 	std::shared_ptr<Lambertian> diffuse;
 
 	std::shared_ptr<Texture> mix;
 };
 
+// Glass. Smooth below MIN_ROUGHNESS, choosing reflection or refraction by Schlick's Fresnel term,
+// otherwise a GGX microfacet lobe for both (Walter et al. 2007) with alpha = roughness^2. Like the
+// smooth case, refraction leaves out the 1 / eta^2 scaling of radiance, which cancels out through
+// any closed object and keeps the BSDF the same both ways along a path.
 class Dielectric : public Material
 {
 public:
 	Dielectric(MatScalar indexOfRefraction, MatScalar roughness) : ir(indexOfRefraction), r(roughness) { }
 
-	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered) const override
+	virtual bool scatter(const ray& r_in, const hitRecord& rec, glm::vec3& attenuation, ray& scattered, Sampler& sampler) const override;
+
+	virtual bool isSpecular(const hitRecord& rec) const override;
+	virtual glm::vec3 eval(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
+	virtual float pdf(const ray& r_in, const hitRecord& rec, const glm::vec3& direction) const override;
+
+	virtual BounceType bounceType(const hitRecord& rec, const glm::vec3& direction) const override
 	{
-		attenuation = glm::vec3(1, 1, 1);
-		float refractionRatio = rec.frontFace ? (1.0f / ir.valueAt(rec.u, rec.v, rec.p)) : ir.valueAt(rec.u, rec.v, rec.p);
+		return glm::dot(direction, rec.normal) < 0.0f ? BounceType::Transmission : BounceType::Glossy;
+	}
 
-		glm::vec3 unitDirection = glm::normalize(r_in.dir);
-		double cosTheta = glm::min(glm::dot(-unitDirection, rec.normal), 1.0f);
-		double sinTheta = glm::sqrt(1.0 - cosTheta * cosTheta);
+private:
+	static constexpr float MIN_ROUGHNESS = 0.01f;
 
-		bool cannot_refract = refractionRatio * sinTheta > 1.0;
-		glm::vec3 direction;
+	float roughnessAt(const hitRecord& rec) const;
 
-		double ref = reflectance(cosTheta, refractionRatio);
+	// Index of refraction on the incoming side over the other, as glm::refract takes it
+	float refractionRatio(const hitRecord& rec) const;
 
-		if (cannot_refract || ref > glm::linearRand(0.0, 1.0))
-		{
-			direction = reflect(unitDirection, rec.normal);
-		}
-		else
-		{
-			direction = glm::refract(unitDirection, rec.normal, refractionRatio);
-		}
+	// What eval() and pdf() share for a pair of directions, seen from wo's side of the surface
+	struct microfacetPair
+	{
+		float cosO, cosI, cosH; // Against the normal on wo's side
+		float oDotH, iDotH;
+		float ratio; // As refractionRatio(), from wo's side
+		float fresnel;
+		float alpha;
+		bool reflected;
+	};
 
-		scattered = ray(rec.p, direction + r.valueAt(rec.u, rec.v, rec.p) * glm::sphericalRand(1.0f));
-		return true;
-	}
+	// False where the BSDF is zero for the pair
+	bool halfVector(const ray& r_in, const hitRecord& rec, const glm::vec3& direction, microfacetPair& m) const;
 
-private:
 	MatScalar ir; // Index of refraction
 	MatScalar r; // Roughness
 
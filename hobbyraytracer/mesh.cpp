@@ -5,12 +5,13 @@
 #include <assimp/scene.h>           // Output data structure
 #include <assimp/postprocess.h>     // Post processing flags
 
+#include <algorithm>
 #include <ranges>
 #include <vector>
 
 Assimp::Importer Mesh::importer;
 
-Mesh::Mesh(std::string filepath, std::shared_ptr<Material> matPtr)
+Mesh::Mesh(std::string filepath, std::shared_ptr<Material> matPtr, std::optional<uint64_t> buildSeed)
 {
 	std::vector<glm::vec3> vertices, normals;
 	std::vector<glm::vec2> uvs;
@@ -34,15 +35,37 @@ Mesh::Mesh(std::string filepath, std::shared_ptr<Material> matPtr)
 		}
 	}
 
-	matPtr = matPtr;
-	tree = std::make_shared<BVHNode>(triangleStrip);
+	auto sampling = std::make_shared<meshSurface>();
+	sampling->triangles = triangleStrip.objects;
+
+	float total = 0.0f;
+	for (const auto& triangle : sampling->triangles)
+	{
+		total += triangle->area();
+		sampling->areaCdf.push_back(total);
+	}
+
+	surface = sampling;
+
+	this->matPtr = matPtr;
+	tree = std::make_shared<BVHNode>(triangleStrip, buildSeed);
 
 	std::cout << "Indexed file: " << filepath << std::endl;
 }
 
 bool Mesh::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
 {
-	return tree->hit(r, t_min, t_max, rec);
+	if (!tree->hit(r, t_min, t_max, rec))
+		return false;
+
+	// The triangles may have been built with another material, see the sharing constructor
+	rec.matPtr = matPtr;
+	return true;
+}
+
+bool Mesh::occluded(const ray& r, float t_min, float t_max) const
+{
+	return tree->occluded(r, t_min, t_max);
 }
 
 bool Mesh::boundingBox(AABB& outputBox)
@@ -50,6 +73,21 @@ bool Mesh::boundingBox(AABB& outputBox)
 	return tree->boundingBox(outputBox);
 }
 
+float Mesh::area() const
+{
+	return surface->areaCdf.empty() ? 0.0f : surface->areaCdf.back();
+}
+
+surfaceSample Mesh::sampleSurface(Sampler& sampler) const
+{
+	const std::vector<float>& cdf = surface->areaCdf;
+
+	float target = sampler.nextFloat() * cdf.back();
+	size_t index = std::upper_bound(cdf.begin(), cdf.end(), target) - cdf.begin();
+
+	return surface->triangles[glm::min(index, cdf.size() - 1)]->sampleSurface(sampler);
+}
+
 bool Mesh::assimpLoadFile(
     std::string path, std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<glm::vec2>& uvs, std::vector<unsigned int>& indices)
 {
@@ -14,13 +14,30 @@ struct aiScene;
 class Mesh : public Hittable
 {
 public:
-	Mesh(std::string filepath, std::shared_ptr<Material> matPtr);
+	Mesh(std::string filepath, std::shared_ptr<Material> matPtr, std::optional<uint64_t> buildSeed = std::nullopt);
+
+	// Shares the triangles and BVH of an already loaded mesh, with a different material
+	Mesh(const Mesh& geometry, std::shared_ptr<Material> matPtr) : tree(geometry.tree), surface(geometry.surface), matPtr(matPtr) { }
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual float area() const override;
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
+	virtual std::vector<std::shared_ptr<Hittable>> split() const override { return surface->triangles; }
+
 private:
+	// The triangles again with a running total of their areas, for picking one by area in
+	// O(log n) when the mesh is an emitter
+	struct meshSurface
+	{
+		std::vector<std::shared_ptr<Hittable>> triangles;
+		std::vector<float> areaCdf;
+	};
+
 	static Assimp::Importer importer;
 
 	static bool assimpLoadFile(
@@ -31,5 +48,6 @@ private:
 		std::vector<unsigned int>& indices);
 
 	std::shared_ptr<BVHNode> tree;
+	std::shared_ptr<const meshSurface> surface;
 	std::shared_ptr<Material> matPtr;
 };
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include "hobbyraytracer.h"
+#include "numa.h"
+
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if defined(__linux__)
+// Parse a kernel cpu list such as "0-11,24-35"
+static std::vector<int> parseCpuList(const std::string& list)
+{
+	std::vector<int> cpus;
+	std::stringstream ss(list);
+	std::string range;
+
+	while (std::getline(ss, range, ','))
+	{
+		if (range.empty() || range == "\n")
+			continue;
+
+		size_t dash = range.find('-');
+		int first = std::stoi(range.substr(0, dash));
+		int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+		for (int c = first; c <= last; c++)
+		{
+			cpus.push_back(c);
+		}
+	}
+
+	return cpus;
+}
+#endif
+
+NumaTopology NumaTopology::detect()
+{
+	NumaTopology topology;
+
+#if defined(_WIN32)
+	ULONG highestNode = 0;
+	if (GetNumaHighestNodeNumber(&highestNode))
+	{
+		for (USHORT node = 0; node <= highestNode; node++)
+		{
+			GROUP_AFFINITY affinity;
+			if (!GetNumaNodeProcessorMaskEx(node, &affinity))
+				continue;
+
+			// Windows numbers processors per group of 64, flatten that into one index
+			std::vector<int> cpus;
+			for (int bit = 0; bit < 64; bit++)
+			{
+				if (affinity.Mask & (KAFFINITY(1) << bit))
+					cpus.push_back(affinity.Group * 64 + bit);
+			}
+
+			if (!cpus.empty())
+				topology.nodeCpus.push_back(cpus);
+		}
+	}
+#elif defined(__linux__)
+	for (int node = 0; ; node++)
+	{
+		std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+		if (!cpulist)
+			break;
+
+		std::string list;
+		std::getline(cpulist, list);
+
+		std::vector<int> cpus = parseCpuList(list);
+		if (!cpus.empty())
+			topology.nodeCpus.push_back(cpus);
+	}
+#endif
+
+	if (topology.nodeCpus.empty())
+	{
+		std::vector<int> cpus(glm::max<int>(std::thread::hardware_concurrency(), 1));
+		for (size_t c = 0; c < cpus.size(); c++)
+		{
+			cpus[c] = static_cast<int>(c);
+		}
+
+		topology.nodeCpus.push_back(cpus);
+	}
+
+	return topology;
+}
+
+bool NumaTopology::pinCurrentThread(const std::vector<int>& cpus)
+{
+	if (cpus.empty())
+		return false;
+
+#if defined(_WIN32)
+	// A thread can only have affinity within a single processor group
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = static_cast<WORD>(cpus[0] / 64);
+
+	for (int cpu : cpus)
+	{
+		if (cpu / 64 == affinity.Group)
+			affinity.Mask |= KAFFINITY(1) << (cpu % 64);
+	}
+
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (int cpu : cpus)
+	{
+		CPU_SET(cpu, &set);
+	}
+
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
\ No newline at end of file
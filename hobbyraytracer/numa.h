@@ -0,0 +1,26 @@
+#pragma once
+
+// The NUMA layout of the machine - which logical processors belong to which memory node.
+// On machines without NUMA (or platforms we can't query) everything is reported as node 0.
+class NumaTopology
+{
+public:
+	static NumaTopology detect();
+
+	int numNodes() const { return static_cast<int>(nodeCpus.size()); }
+	const std::vector<int>& getCpus(int node) const { return nodeCpus[node]; }
+
+	// Workers are dealt round robin across the nodes, then across the cpus within a node
+	int workerNode(int worker) const { return worker % numNodes(); }
+	int workerCpu(int worker) const
+	{
+		const std::vector<int>& cpus = nodeCpus[workerNode(worker)];
+		return cpus[(worker / numNodes()) % cpus.size()];
+	}
+
+	// Restrict the calling thread to the given logical processors
+	static bool pinCurrentThread(const std::vector<int>& cpus);
+
+private:
+	std::vector<std::vector<int>> nodeCpus;
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "hobbyraytracer.h"
+#include "photonMap.h"
+
+#include "material.h"
+
+// Photons on a surface facing more than 60 degrees away belong to something else, e.g. the other
+// side of a thin wall or the next face round a corner
+constexpr float MIN_NORMAL_COSINE = 0.5f;
+
+uint32_t PhotonMap::cellIndex(const glm::ivec3& cell) const
+{
+	// Teschner et al. 2003
+	uint32_t h = ((uint32_t)cell.x * 73856093u) ^ ((uint32_t)cell.y * 19349663u) ^ ((uint32_t)cell.z * 83492791u);
+	return h & (uint32_t)(cellStart.size() - 2);
+}
+
+glm::ivec3 PhotonMap::cellOf(const glm::vec3& p) const
+{
+	return glm::ivec3(glm::floor(p / cellSize));
+}
+
+void PhotonMap::build(std::vector<photon> stored, float gatherRadius)
+{
+	radius = gatherRadius;
+	cellSize = 2.0f * gatherRadius;
+
+	photons.clear();
+	cellStart.clear();
+
+	if (stored.empty())
+		return;
+
+	// A power of two at least as big as the photon count, so most buckets hold one cell
+	size_t buckets = 1;
+	while (buckets < stored.size())
+		buckets *= 2;
+
+	cellStart.assign(buckets + 1, 0);
+
+	std::vector<uint32_t> bucketOf(stored.size());
+
+	for (size_t i = 0; i < stored.size(); i++)
+	{
+		bucketOf[i] = cellIndex(cellOf(stored[i].p));
+		cellStart[bucketOf[i] + 1]++;
+	}
+
+	for (size_t b = 0; b < buckets; b++)
+		cellStart[b + 1] += cellStart[b];
+
+	std::vector<uint32_t> next(cellStart.begin(), cellStart.end() - 1);
+	photons.resize(stored.size());
+
+	for (size_t i = 0; i < stored.size(); i++)
+		photons[next[bucketOf[i]]++] = stored[i];
+}
+
+glm::vec3 PhotonMap::estimate(const ray& r_in, const hitRecord& rec) const
+{
+	if (photons.empty())
+		return glm::vec3(0.0f);
+
+	glm::vec3 normal = glm::normalize(rec.normal);
+	glm::vec3 result(0.0f);
+
+	// Cells are as wide as the gather sphere, so along each axis it only reaches the neighbour
+	// on whichever side of its cell's centre it is
+	glm::vec3 local = rec.p / cellSize;
+	glm::ivec3 cell = cellOf(rec.p);
+	glm::ivec3 first, last;
+
+	for (int a = 0; a < 3; a++)
+	{
+		bool lower = local[a] - std::floor(local[a]) < 0.5f;
+		first[a] = lower ? cell[a] - 1 : cell[a];
+		last[a] = first[a] + 1;
+	}
+
+	// Two neighbouring cells can hash to the same bucket, which must only be read once
+	std::array<uint32_t, 8> visited;
+	int visitedCount = 0;
+
+	for (int z = first.z; z <= last.z; z++)
+	{
+		for (int y = first.y; y <= last.y; y++)
+		{
+			for (int x = first.x; x <= last.x; x++)
+			{
+				uint32_t bucket = cellIndex(glm::ivec3(x, y, z));
+
+				if (std::find(visited.begin(), visited.begin() + visitedCount, bucket) != visited.begin() + visitedCount)
+					continue;
+
+				visited[visitedCount++] = bucket;
+
+				for (uint32_t i = cellStart[bucket]; i < cellStart[bucket + 1]; i++)
+				{
+					const photon& ph = photons[i];
+
+					glm::vec3 offset = ph.p - rec.p;
+					if (glm::dot(offset, offset) > radius * radius || glm::dot(ph.normal, normal) < MIN_NORMAL_COSINE)
+						continue;
+
+					// eval() includes the cosine at the receiver, which the photon's power already does
+					float cosine = glm::dot(normal, ph.direction);
+					if (cosine <= 1e-4f)
+						continue;
+
+					result += rec.matPtr->eval(r_in, rec, ph.direction) / cosine * ph.power;
+				}
+			}
+		}
+	}
+
+	return result / (glm::pi<float>() * radius * radius);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "hittable.h"
+
+// A photon left on a non-specular surface
+struct photon
+{
+	glm::vec3 p;
+	glm::vec3 normal; // Of the surface, on the side the photon arrived from
+	glm::vec3 direction; // Back the way it came
+	glm::vec3 power; // Already divided by the number of photons emitted
+};
+
+// Photons in a hashed uniform grid with cells twice the gather radius across, so a query only
+// ever has to look at the 2x2x2 cells its sphere overlaps. Built once per pass and then only read.
+class PhotonMap
+{
+public:
+	// Sorts photons into cells with a counting sort, so the order they end up in (and so the sum
+	// a query adds up) doesn't depend on how many threads traced them
+	void build(std::vector<photon> photons, float radius);
+
+	bool empty() const { return photons.empty(); }
+	size_t size() const { return photons.size(); }
+
+	// Radiance leaving rec towards r_in's origin from the photons within the radius, each
+	// weighted by the BSDF, over the area of the gather disc
+	glm::vec3 estimate(const ray& r_in, const hitRecord& rec) const;
+
+private:
+	uint32_t cellIndex(const glm::ivec3& cell) const;
+	glm::ivec3 cellOf(const glm::vec3& p) const;
+
+	std::vector<photon> photons;
+	std::vector<uint32_t> cellStart; // Into photons, one more than there are hash buckets
+
+	float radius = 0.0f;
+	float cellSize = 1.0f;
+};
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "hobbyraytracer.h"
+#include "radianceCache.h"
+
+#include "random.h"
+
+#include <bit>
+#include <execution>
+#include <numeric>
+
+// Sums are kept in fixed point, like the guide's flux, so a cell's mean doesn't depend on the order
+// workers' samples land in
+constexpr double CACHE_FIXED_POINT_SCALE = 1 << 16;
+
+// A single sample can't claim more than this, so one path that found a light by chance doesn't
+// light up a whole cell, or overflow it
+constexpr float MAX_RECORDED_RADIANCE = 1e4f;
+
+// Cells looked at past the one a key hashes to before giving up on it
+constexpr int MAX_PROBES = 16;
+
+// Cells updated together, the unit of parallel work in update()
+constexpr size_t UPDATE_BLOCK = 4096;
+
+RadianceCache::RadianceCache(float cellSize, size_t cellCount)
+	: cells(std::max<size_t>(std::bit_ceil(cellCount), 1)), cellSize(cellSize)
+{
+}
+
+uint64_t RadianceCache::keyOf(const glm::vec3& p, const glm::vec3& normal) const
+{
+	// 20 bits per axis wrap round every million cells, far enough apart to not meet in one table
+	glm::ivec3 cell = glm::ivec3(glm::floor(p / cellSize));
+	uint64_t x = (uint64_t)(uint32_t)cell.x & 0xfffff;
+	uint64_t y = (uint64_t)(uint32_t)cell.y & 0xfffff;
+	uint64_t z = (uint64_t)(uint32_t)cell.z & 0xfffff;
+
+	// Which of the six axis directions the normal is closest to
+	glm::vec3 a = glm::abs(normal);
+	int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+	uint64_t facing = (uint64_t)(2 * axis + (normal[axis] < 0.0f));
+
+	// The top bit keeps every key away from 0, which marks an empty cell
+	return (1ULL << 63) | (facing << 60) | (z << 40) | (y << 20) | x;
+}
+
+int64_t RadianceCache::find(uint64_t key, bool insert)
+{
+	size_t mask = cells.size() - 1;
+	size_t start = (size_t)mixBits(key) & mask;
+
+	for (int probe = 0; probe < MAX_PROBES; probe++)
+	{
+		size_t i = (start + probe) & mask;
+		uint64_t current = cells[i].key.load(std::memory_order_relaxed);
+
+		if (current == key)
+			return (int64_t)i;
+
+		if (current != 0)
+			continue;
+
+		if (!insert)
+			return -1;
+
+		// Another worker may claim it first, for this key or another one
+		if (cells[i].key.compare_exchange_strong(current, key, std::memory_order_relaxed) || current == key)
+			return (int64_t)i;
+	}
+
+	return -1;
+}
+
+int64_t RadianceCache::find(uint64_t key) const
+{
+	return const_cast<RadianceCache*>(this)->find(key, false);
+}
+
+void RadianceCache::record(const glm::vec3& p, const glm::vec3& normal, const glm::vec3& radiance)
+{
+	int64_t i = find(keyOf(p, normal), true);
+	if (i < 0)
+		return;
+
+	cacheCell& cell = cells[i];
+
+	for (int c = 0; c < 3; c++)
+	{
+		int64_t fixed = static_cast<int64_t>(std::llround(glm::clamp(radiance[c], 0.0f, MAX_RECORDED_RADIANCE) * CACHE_FIXED_POINT_SCALE));
+
+		if (fixed != 0)
+			std::atomic_ref<int64_t>(cell.radiance[c]).fetch_add(fixed, std::memory_order_relaxed);
+	}
+
+	std::atomic_ref<uint64_t>(cell.samples).fetch_add(1, std::memory_order_relaxed);
+}
+
+bool RadianceCache::lookup(const glm::vec3& p, const glm::vec3& normal, uint64_t minSamples, glm::vec3& radiance) const
+{
+	int64_t i = find(keyOf(p, normal));
+
+	if (i < 0 || cells[i].meanSamples < glm::max(minSamples, (uint64_t)1))
+		return false;
+
+	radiance = cells[i].mean;
+	return true;
+}
+
+void RadianceCache::update()
+{
+	std::vector<size_t> blocks((cells.size() + UPDATE_BLOCK - 1) / UPDATE_BLOCK);
+	std::iota(blocks.begin(), blocks.end(), (size_t)0);
+
+	std::for_each(std::execution::par, blocks.begin(), blocks.end(), [this](size_t block) {
+		size_t end = glm::min((block + 1) * UPDATE_BLOCK, cells.size());
+
+		for (size_t i = block * UPDATE_BLOCK; i < end; i++)
+		{
+			cacheCell& cell = cells[i];
+
+			if (cell.samples == 0)
+				continue;
+
+			double scale = 1.0 / (CACHE_FIXED_POINT_SCALE * (double)cell.samples);
+
+			for (int c = 0; c < 3; c++)
+				cell.mean[c] = (float)((double)cell.radiance[c] * scale);
+
+			cell.meanSamples = cell.samples;
+		}
+	});
+}
+
+size_t RadianceCache::usedCells() const
+{
+	return (size_t)std::count_if(cells.begin(), cells.end(), [](const cacheCell& cell) {
+		return cell.key.load(std::memory_order_relaxed) != 0;
+	});
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ray.h"
+
+// Radiance leaving surfaces, averaged over the cells of a world-space grid (Binder et al. 2019,
+// Fast Path Space Filtering by Jittered Spatial Hashing). Cells are split further by which way the
+// surface faces, so the two sides of a wall or the faces round a corner don't share. The cells
+// live in a fixed-size hash table, filled in lock-free by the workers and turned into the values
+// lookups see between passes.
+class RadianceCache
+{
+public:
+	RadianceCache(float cellSize, size_t cells);
+
+	// Add a sample of the radiance leaving p, whose normal faces the way it leaves. Safe to call
+	// concurrently. Dropped if the table has no room left near the cell's hash.
+	void record(const glm::vec3& p, const glm::vec3& normal, const glm::vec3& radiance);
+
+	// Mean radiance of the cell holding p as of the last update(), false until it has at least
+	// minSamples
+	bool lookup(const glm::vec3& p, const glm::vec3& normal, uint64_t minSamples, glm::vec3& radiance) const;
+
+	// Make every sample recorded so far visible to lookups, with no render in flight
+	void update();
+
+	float getCellSize() const { return cellSize; }
+	size_t usedCells() const;
+	size_t memory() const { return cells.size() * sizeof(cacheCell); }
+
+private:
+	struct cacheCell
+	{
+		std::atomic<uint64_t> key = 0; // 0 = empty
+		std::array<int64_t, 3> radiance{}; // Every sample so far, in fixed point
+		uint64_t samples = 0;
+
+		glm::vec3 mean = glm::vec3(0.0f); // What lookups return
+		uint64_t meanSamples = 0;
+	};
+
+	uint64_t keyOf(const glm::vec3& p, const glm::vec3& normal) const;
+
+	// The cell holding key, claiming an empty one for it if insert is set, -1 if there's none
+	int64_t find(uint64_t key, bool insert);
+	int64_t find(uint64_t key) const;
+
+	std::vector<cacheCell> cells;
+	float cellSize;
+};
\ No newline at end of file
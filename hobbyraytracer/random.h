@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+// Bijective 64 bit finaliser (splitmix64), used to turn structured indices into seeds
+inline uint64_t mixBits(uint64_t v)
+{
+	v ^= v >> 30;
+	v *= 0xbf58476d1ce4e5b9ULL;
+	v ^= v >> 27;
+	v *= 0x94d049bb133111ebULL;
+	v ^= v >> 31;
+	return v;
+}
+
+inline uint64_t hashCombine(uint64_t seed, uint64_t v)
+{
+	return mixBits(seed ^ (v + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// PCG32 generator (https://www.pcg-random.org) - 16 bytes of state, no locking and much
+// better statistics than the std::rand style generators behind glm's random functions.
+// Behind IndependentSampler and the per sample jitter of StratifiedSampler, see sampler.h.
+class PCG32
+{
+public:
+	PCG32() : PCG32(0x853c49e6748fea9bULL) { }
+
+	explicit PCG32(uint64_t seed, uint64_t stream = 0xda3e39cb94b95bdbULL)
+	{
+		state = 0;
+		inc = (stream << 1) | 1;
+		next();
+		state += seed;
+		next();
+	}
+
+	uint32_t next()
+	{
+		uint64_t old = state;
+		state = old * 0x5851f42d4c957f2dULL + inc;
+
+		uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+		uint32_t rot = static_cast<uint32_t>(old >> 59);
+
+		return (xorshifted >> rot) | (xorshifted << ((~rot + 1) & 31));
+	}
+
+	// Uniform float in [0, 1)
+	float nextFloat()
+	{
+		return static_cast<float>(next() >> 8) * 0x1p-24f;
+	}
+
+	// Uniform float in [a, b)
+	float nextFloat(float a, float b)
+	{
+		return a + (b - a) * nextFloat();
+	}
+
+	// Uniform int in [a, b]
+	int nextInt(int a, int b)
+	{
+		return a + static_cast<int>(next() % static_cast<uint32_t>(b - a + 1));
+	}
+
+private:
+	uint64_t state;
+	uint64_t inc;
+};
\ No newline at end of file
@@ -0,0 +1,19 @@
+#include "hobbyraytracer.h"
+#include "renderer.h"
+
+void renderPixel(const RenderContext& ctx, glm::ivec2 dimensions, Sampler& sampler, glm::ivec2 pixel,
+	int firstSample, int count, FilmTile& filmTile, RayStats& stats)
+{
+	int x = pixel.x;
+	int y = dimensions.y - pixel.y;
+
+	for (int s = firstSample; s < firstSample + count; s++)
+	{
+		sampler.startSample(pixel, s);
+
+		float u = ((float)x + sampler.nextFloat()) / (dimensions.x - 1);
+		float v = ((float)y + sampler.nextFloat()) / (dimensions.y - 1);
+
+		filmTile.addSample(pixel, ctx.integrator->Li(ctx.camera.getRay(u, v, sampler), ctx, sampler, stats));
+	}
+}
\ No newline at end of file
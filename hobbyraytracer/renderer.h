@@ -0,0 +1,32 @@
+#pragma once
+
+#include "hittable.h"
+#include "texture.h"
+#include "camera.h"
+#include "film.h"
+#include "telemetry.h"
+#include "lights.h"
+#include "integrator.h"
+
+// Everything a worker needs to trace rays - one per NUMA node when the scene is replicated
+struct RenderContext
+{
+	std::shared_ptr<Texture> background;
+	std::shared_ptr<Hittable> world;
+	std::shared_ptr<LightList> lights;
+	std::shared_ptr<Integrator> integrator;
+	sampler_desc sampler;
+	Camera camera;
+
+	// What a render is writing to, for integrators that add light anywhere in the image (e.g.
+	// bidirectional path tracing's light tracing). Null when the image is elsewhere, as it is for
+	// a distributed worker.
+	Film* film = nullptr;
+};
+
+// Trace samples [firstSample, firstSample + count) of one pixel into the tile. Each sample's
+// random numbers only depend on (seed, pixel, sample index), so the result doesn't depend on
+// which thread, or which process, takes them. sampler is the calling worker's own, made once
+// with Sampler::create and reused from pixel to pixel, as startSample() resets it.
+void renderPixel(const RenderContext& ctx, glm::ivec2 dimensions, Sampler& sampler, glm::ivec2 pixel,
+	int firstSample, int count, FilmTile& filmTile, RayStats& stats);
\ No newline at end of file
@@ -48,7 +48,9 @@ bool RotateQuat::hit(const ray& r, float t_min, float t_max, hitRecord& rec) con
     glm::vec3 direction = r.dir;
     glm::quat invRotation = glm::conjugate(rotation);
     glm::vec3 newOrigin = invRotation * origin;
-    glm::vec3 newDirection = glm::normalize(invRotation * direction);
+    // Not normalised: a rotation keeps the length, and renormalising would make the child's t
+    // disagree with the caller's ray whenever the caller's direction isn't unit length
+    glm::vec3 newDirection = invRotation * direction;
     ray rotatedRay(newOrigin, newDirection);
 
     // Check for intersection with the rotated object
@@ -65,8 +67,43 @@ bool RotateQuat::hit(const ray& r, float t_min, float t_max, hitRecord& rec) con
     return true;
 }
 
+bool RotateQuat::occluded(const ray& r, float t_min, float t_max) const
+{
+    glm::quat invRotation = glm::conjugate(rotation);
+
+    return ptr->occluded(ray(invRotation * r.o, invRotation * r.dir), t_min, t_max);
+}
+
 bool RotateQuat::boundingBox(AABB& outputBox)
 {
     outputBox = bBox;
     return hasBox;
 }
+
+surfaceSample RotateQuat::sampleSurface(Sampler& sampler) const
+{
+    surfaceSample sample = ptr->sampleSurface(sampler);
+    sample.p = rotation * sample.p;
+    sample.normal = rotation * sample.normal;
+
+    return sample;
+}
+
+std::vector<std::shared_ptr<Hittable>> RotateQuat::split() const
+{
+    std::vector<std::shared_ptr<Hittable>> pieces;
+
+    for (const auto& piece : ptr->split())
+        pieces.push_back(std::make_shared<RotateQuat>(piece, rotation));
+
+    return pieces;
+}
+
+bool RotateQuat::normalBounds(glm::vec3& axis, float& cosTheta) const
+{
+    if (!ptr->normalBounds(axis, cosTheta))
+        return false;
+
+    axis = rotation * axis;
+    return true;
+}
\ No newline at end of file
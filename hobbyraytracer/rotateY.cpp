@@ -41,7 +41,7 @@ RotateY::RotateY(std::shared_ptr<Hittable> p, float angle)
     bBox = AABB(min, max);
 }
 
-bool RotateY::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+ray RotateY::rotate(const ray& r) const
 {
     glm::vec3 origin = r.o; 
     glm::vec3 direction = r.dir;
@@ -52,7 +52,12 @@ bool RotateY::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     direction[0] = cosTheta * r.dir[0] - sinTheta * r.dir[2];
     direction[2] = sinTheta * r.dir[0] + cosTheta * r.dir[2];
 
-    ray rotatedR(origin, direction);
+    return ray(origin, direction);
+}
+
+bool RotateY::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+{
+    ray rotatedR = rotate(r);
 
     if (!ptr->hit(rotatedR, t_min, t_max, rec))
     {
@@ -74,6 +79,11 @@ bool RotateY::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     return true;
 }
 
+bool RotateY::occluded(const ray& r, float t_min, float t_max) const
+{
+    return ptr->occluded(rotate(r), t_min, t_max);
+}
+
 bool RotateY::boundingBox(AABB& outputBox)
 {
     outputBox = bBox;
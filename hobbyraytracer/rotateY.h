@@ -14,7 +14,13 @@ private:
 	bool hasBox;
 	AABB bBox;
 
+	// r in the object's own space
+	ray rotate(const ray& r) const;
+
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
+
+	virtual const Hittable* primitive() const override { return ptr->primitive(); }
 };
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include "hobbyraytracer.h"
+#include "sampler.h"
+
+// Largest float below 1, so nothing rounds up out of [0, 1)
+constexpr float ONE_MINUS_EPSILON = 0x1.fffffep-1f;
+
+// Blue noise mask edge length, a power of two
+constexpr int MASK_SIZE = 64;
+
+std::unique_ptr<Sampler> Sampler::create(const sampler_desc& desc, glm::ivec2 dimensions, uint64_t seed)
+{
+	switch (desc.type)
+	{
+	case SamplerType::Independent:
+		return std::make_unique<IndependentSampler>(seed, dimensions.x);
+	case SamplerType::Stratified:
+		return std::make_unique<StratifiedSampler>(seed, dimensions.x, desc.samples);
+	case SamplerType::BlueNoise:
+		return std::make_unique<SobolSampler>(seed, dimensions.x, true);
+	case SamplerType::Sobol:
+	default:
+		return std::make_unique<SobolSampler>(seed, dimensions.x, false);
+	}
+}
+
+void IndependentSampler::startSample(glm::ivec2 pixel, int index)
+{
+	rng = PCG32(hashCombine(hashCombine(seed, pixel.y * width + pixel.x), index));
+}
+
+// SOBOL
+
+// Generator matrix columns of the first four Sobol dimensions, from Joe and Kuo's primitive
+// polynomials and initial direction numbers (dimension 0 is van der Corput)
+static const std::array<std::array<uint32_t, 32>, 4>& sobolDirections()
+{
+	static const std::array<std::array<uint32_t, 32>, 4> directions = []() {
+		struct polynomial { int degree; uint32_t coefficients; std::array<uint32_t, 3> initial; };
+		const polynomial polynomials[3] = { { 1, 0, { 1 } }, { 2, 1, { 1, 3 } }, { 3, 1, { 1, 3, 1 } } };
+
+		std::array<std::array<uint32_t, 32>, 4> v;
+
+		for (int k = 0; k < 32; k++)
+			v[0][k] = 1u << (31 - k);
+
+		for (int d = 1; d < 4; d++)
+		{
+			const polynomial& p = polynomials[d - 1];
+			uint32_t m[32];
+
+			for (int k = 0; k < 32; k++)
+			{
+				if (k < p.degree)
+				{
+					m[k] = p.initial[k];
+					continue;
+				}
+
+				m[k] = m[k - p.degree] ^ (m[k - p.degree] << p.degree);
+				for (int i = 1; i < p.degree; i++)
+				{
+					if ((p.coefficients >> (p.degree - 1 - i)) & 1)
+						m[k] ^= m[k - i] << i;
+				}
+			}
+
+			for (int k = 0; k < 32; k++)
+				v[d][k] = m[k] << (31 - k);
+		}
+
+		return v;
+	}();
+
+	return directions;
+}
+
+static uint32_t sobol(uint32_t index, int dimension)
+{
+	const std::array<uint32_t, 32>& v = sobolDirections()[dimension];
+	uint32_t x = 0;
+
+	for (int bit = 0; index; bit++, index >>= 1)
+	{
+		if (index & 1)
+			x ^= v[bit];
+	}
+
+	return x;
+}
+
+static uint32_t reverseBits(uint32_t x)
+{
+	x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+	x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+	x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+	x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+// Owen scrambling as a hash: every output bit only depends on the bits above it (Burley 2020)
+static uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+{
+	x = reverseBits(x);
+
+	x ^= x * 0x3d20adeau;
+	x += seed;
+	x *= (seed >> 16) | 1;
+	x ^= x * 0x05526c56u;
+	x ^= x * 0x53a22864u;
+
+	return reverseBits(x);
+}
+
+// Void and cluster (Ulichney 1993) blue noise ranks, as thresholds in [0, 1). Built once, the
+// same every time, on first use.
+static const std::vector<float>& blueNoiseMask()
+{
+	static const std::vector<float> mask = []() {
+		constexpr int N = MASK_SIZE * MASK_SIZE;
+		constexpr float SIGMA = 1.5f;
+
+		// Gaussian energy of a point at the origin, over the torus
+		std::vector<float> kernel(N);
+		for (int y = 0; y < MASK_SIZE; y++)
+		{
+			for (int x = 0; x < MASK_SIZE; x++)
+			{
+				int dx = glm::min(x, MASK_SIZE - x);
+				int dy = glm::min(y, MASK_SIZE - y);
+				kernel[y * MASK_SIZE + x] = glm::exp(-(float)(dx * dx + dy * dy) / (2.0f * SIGMA * SIGMA));
+			}
+		}
+
+		std::vector<uint8_t> pattern(N, 0);
+		std::vector<float> energy(N, 0.0f);
+
+		auto toggle = [&](std::vector<uint8_t>& p, std::vector<float>& e, int i) {
+			float sign = p[i] ? -1.0f : 1.0f;
+			p[i] ^= 1;
+
+			int px = i % MASK_SIZE, py = i / MASK_SIZE;
+			for (int y = 0; y < MASK_SIZE; y++)
+			{
+				const float* row = &kernel[((y - py) & (MASK_SIZE - 1)) * MASK_SIZE];
+				for (int x = 0; x < MASK_SIZE; x++)
+					e[y * MASK_SIZE + x] += sign * row[(x - px) & (MASK_SIZE - 1)];
+			}
+		};
+
+		// Tightest cluster among the set points, or largest void among the empty ones
+		auto extreme = [&](const std::vector<uint8_t>& p, const std::vector<float>& e, bool cluster) {
+			int best = -1;
+			for (int i = 0; i < N; i++)
+			{
+				if (p[i] != (cluster ? 1 : 0))
+					continue;
+
+				if (best < 0 || (cluster ? e[i] > e[best] : e[i] < e[best]))
+					best = i;
+			}
+			return best;
+		};
+
+		// Random initial pattern, then swap clusters into voids until it settles
+		PCG32 rng(MASK_SIZE);
+		int initial = N / 10;
+
+		for (int placed = 0; placed < initial; )
+		{
+			int i = rng.nextInt(0, N - 1);
+			if (!pattern[i])
+			{
+				toggle(pattern, energy, i);
+				placed++;
+			}
+		}
+
+		for (int iteration = 0; iteration < N; iteration++)
+		{
+			int c = extreme(pattern, energy, true);
+			toggle(pattern, energy, c);
+
+			int v = extreme(pattern, energy, false);
+			toggle(pattern, energy, v);
+
+			if (v == c)
+				break;
+		}
+
+		std::vector<int> rank(N, 0);
+
+		// Rank the initial points by repeatedly removing the tightest cluster
+		{
+			std::vector<uint8_t> p = pattern;
+			std::vector<float> e = energy;
+
+			for (int r = initial - 1; r >= 0; r--)
+			{
+				int c = extreme(p, e, true);
+				toggle(p, e, c);
+				rank[c] = r;
+			}
+		}
+
+		// Then the rest by repeatedly filling the largest void
+		for (int r = initial; r < N; r++)
+		{
+			int v = extreme(pattern, energy, false);
+			toggle(pattern, energy, v);
+			rank[v] = r;
+		}
+
+		std::vector<float> thresholds(N);
+		for (int i = 0; i < N; i++)
+			thresholds[i] = (rank[i] + 0.5f) / N;
+
+		return thresholds;
+	}();
+
+	return mask;
+}
+
+void SobolSampler::startSample(glm::ivec2 p, int i)
+{
+	pixel = p;
+	index = (uint32_t)i;
+	dimension = 0;
+
+	// Blue noise shares one sequence between every pixel, the mask decorrelates them instead
+	scrambleSeed = blueNoise ? seed : hashCombine(seed, pixel.y * width + pixel.x);
+}
+
+float SobolSampler::nextFloat()
+{
+	int chunk = dimension / 4;
+	int d = dimension % 4;
+
+	if (d == 0)
+		shuffledIndex = nestedUniformScramble(index, (uint32_t)hashCombine(scrambleSeed, 2 * chunk));
+
+	uint32_t x = nestedUniformScramble(sobol(shuffledIndex, d), (uint32_t)hashCombine(scrambleSeed, 2 * dimension + 1));
+	float value = (float)(x >> 8) * 0x1p-24f;
+
+	if (blueNoise)
+	{
+		// A different toroidal offset into the mask for every dimension
+		uint64_t offset = hashCombine(seed ^ 0x5bd1e995ULL, dimension);
+		int mx = (pixel.x + (int)(offset & (MASK_SIZE - 1))) & (MASK_SIZE - 1);
+		int my = (pixel.y + (int)((offset >> 16) & (MASK_SIZE - 1))) & (MASK_SIZE - 1);
+
+		value += blueNoiseMask()[my * MASK_SIZE + mx];
+		if (value >= 1.0f)
+			value -= 1.0f;
+	}
+
+	dimension++;
+
+	return glm::min(value, ONE_MINUS_EPSILON);
+}
+
+// STRATIFIED
+
+// Element i of a pseudo random permutation of [0, l), chosen by p (Kensler 2013)
+static uint32_t permute(uint32_t i, uint32_t l, uint32_t p)
+{
+	uint32_t w = l - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+
+	do
+	{
+		i ^= p; i *= 0xe170893du;
+		i ^= p >> 16;
+		i ^= (i & w) >> 4;
+		i ^= p >> 8; i *= 0x0929eb3fu;
+		i ^= p >> 23;
+		i ^= (i & w) >> 1; i *= 1 | p >> 27;
+		i *= 0x6935fa69u;
+		i ^= (i & w) >> 11; i *= 0x74dcb303u;
+		i ^= (i & w) >> 2; i *= 0x9e501cc3u;
+		i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+		i &= w;
+		i ^= i >> 5;
+	} while (i >= l);
+
+	return (i + p) % l;
+}
+
+void StratifiedSampler::startSample(glm::ivec2 pixel, int i)
+{
+	pixelSeed = hashCombine(seed, pixel.y * width + pixel.x);
+	index = i;
+	dimension = 0;
+	jitter = PCG32(hashCombine(pixelSeed, index));
+}
+
+float StratifiedSampler::nextFloat()
+{
+	// Past the sample count (e.g. resuming with more samples) start another round of strata
+	int round = index / samples;
+	uint32_t stratum = permute((uint32_t)(index % samples), (uint32_t)samples,
+		(uint32_t)hashCombine(hashCombine(pixelSeed, dimension), round));
+
+	dimension++;
+
+	return glm::min((stratum + jitter.nextFloat()) / samples, ONE_MINUS_EPSILON);
+}
\ No newline at end of file
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "random.h"
+
+enum class SamplerType
+{
+	Independent,
+	Sobol,
+	Stratified,
+	BlueNoise
+};
+
+struct sampler_desc
+{
+	SamplerType type = SamplerType::Independent; // Scenes opt into the others, so old ones render as they did
+	int samples = 1; // Samples per pixel, the number of strata for Stratified
+};
+
+// Source of the random numbers for camera samples. startSample() picks which sample of which
+// pixel is being taken and each nextFloat() after it is the next dimension of that sample's
+// point - pixel jitter, lens, then every light, BSDF and roulette decision along the path.
+// Everything drawn is a function of (seed, pixel, sample index), so renders stay reproducible
+// across threads, processes and resumes. Samplers hold state, so each thread makes its own.
+class Sampler
+{
+public:
+	virtual ~Sampler() = default;
+
+	virtual void startSample(glm::ivec2 pixel, int index) = 0;
+
+	// Next dimension of the current sample, uniform in [0, 1)
+	virtual float nextFloat() = 0;
+
+	// Uniform float in [a, b)
+	float nextFloat(float a, float b)
+	{
+		return a + (b - a) * nextFloat();
+	}
+
+	// dimensions is the film size, for turning pixels into seeds
+	static std::unique_ptr<Sampler> create(const sampler_desc& desc, glm::ivec2 dimensions, uint64_t seed);
+};
+
+// Every dimension from one PCG32 stream per sample - no stratification at all
+class IndependentSampler : public Sampler
+{
+public:
+	// Usable straight away, drawing from seed, until the first startSample()
+	explicit IndependentSampler(uint64_t seed, int width = 1) : rng(seed), seed(seed), width(width) { }
+
+	virtual void startSample(glm::ivec2 pixel, int index) override;
+	virtual float nextFloat() override { return rng.nextFloat(); }
+
+private:
+	PCG32 rng;
+	uint64_t seed;
+	int width;
+};
+
+// Sobol points with hash based Owen scrambling (Burley 2020). The first four dimensions are a 4D
+// Sobol sequence and the rest are padded with further 4D chunks, each with its own shuffle of the
+// sample index and its own scramble so they don't correlate with each other.
+//
+// With blueNoise every pixel shares the same scrambled sequence, shifted (Cranley-Patterson) by a
+// per pixel, per dimension value from a blue noise mask, so the error left between neighbouring
+// pixels is blue noise rather than white (Georgiev and Fajardo 2016).
+class SobolSampler : public Sampler
+{
+public:
+	SobolSampler(uint64_t seed, int width, bool blueNoise) : seed(seed), width(width), blueNoise(blueNoise) { }
+
+	virtual void startSample(glm::ivec2 pixel, int index) override;
+	virtual float nextFloat() override;
+
+private:
+	uint64_t seed;
+	int width;
+	bool blueNoise;
+
+	glm::ivec2 pixel = glm::ivec2(0);
+	uint64_t scrambleSeed = 0;
+	uint32_t index = 0;
+	uint32_t shuffledIndex = 0; // index shuffled for the current chunk of four dimensions
+	int dimension = 0;
+};
+
+// Each dimension split into desc.samples strata, with the sample index permuted separately per
+// pixel and dimension (padded 1D stratification, i.e. a Latin hypercube over each pixel's samples)
+class StratifiedSampler : public Sampler
+{
+public:
+	StratifiedSampler(uint64_t seed, int width, int samples) : seed(seed), width(width), samples(glm::max(samples, 1)) { }
+
+	virtual void startSample(glm::ivec2 pixel, int index) override;
+	virtual float nextFloat() override;
+
+private:
+	uint64_t seed;
+	int width;
+	int samples;
+
+	PCG32 jitter;
+	uint64_t pixelSeed = 0;
+	int index = 0;
+	int dimension = 0;
+};
+
+// SAMPLING HELPERS
+
+// Uniformly distributed point in the unit disk (concentric mapping, no rejection loop)
+inline glm::vec2 randomInUnitDisk(Sampler& sampler)
+{
+	float a = 2.0f * sampler.nextFloat() - 1.0f;
+	float b = 2.0f * sampler.nextFloat() - 1.0f;
+
+	if (a == 0.0f && b == 0.0f)
+		return glm::vec2(0.0f);
+
+	float r, theta;
+	if (glm::abs(a) > glm::abs(b))
+	{
+		r = a;
+		theta = (glm::pi<float>() / 4.0f) * (b / a);
+	}
+	else
+	{
+		r = b;
+		theta = (glm::pi<float>() / 2.0f) - (glm::pi<float>() / 4.0f) * (a / b);
+	}
+
+	return r * glm::vec2(glm::cos(theta), glm::sin(theta));
+}
+
+// Uniformly distributed point on the surface of the unit sphere
+inline glm::vec3 randomUnitVector(Sampler& sampler)
+{
+	float z = 1.0f - 2.0f * sampler.nextFloat();
+	float r = glm::sqrt(glm::max(0.0f, 1.0f - z * z));
+	float phi = 2.0f * glm::pi<float>() * sampler.nextFloat();
+
+	return glm::vec3(r * glm::cos(phi), r * glm::sin(phi), z);
+}
+
+// Uniformly distributed point inside the unit ball
+inline glm::vec3 randomInUnitBall(Sampler& sampler)
+{
+	return randomUnitVector(sampler) * std::cbrt(sampler.nextFloat());
+}
+
+// Orthonormal basis around a unit normal (Duff et al. 2017)
+inline void orthonormalBasis(const glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+{
+	float sign = std::copysign(1.0f, normal.z);
+	float a = -1.0f / (sign + normal.z);
+	float b = normal.x * normal.y * a;
+	tangent = glm::vec3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+	bitangent = glm::vec3(b, sign + normal.y * normal.y * a, -normal.y);
+}
+
+// Cosine weighted direction in the hemisphere around the given unit normal
+inline glm::vec3 randomCosineDirection(const glm::vec3& normal, Sampler& sampler)
+{
+	glm::vec2 d = randomInUnitDisk(sampler);
+	float z = glm::sqrt(glm::max(0.0f, 1.0f - d.x * d.x - d.y * d.y));
+
+	glm::vec3 tangent, bitangent;
+	orthonormalBasis(normal, tangent, bitangent);
+
+	return d.x * tangent + d.y * bitangent + z * normal;
+}
\ No newline at end of file
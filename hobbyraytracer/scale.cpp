@@ -26,6 +26,11 @@ bool Scale::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     return true;
 }
 
+bool Scale::occluded(const ray& r, float t_min, float t_max) const
+{
+    return ptr->occluded(ray(r.o / factor, r.dir / factor), t_min, t_max);
+}
+
 bool Scale::boundingBox(AABB& outputBox)
 {
     outputBox = bBox;
@@ -16,5 +16,8 @@ private:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
+
+	virtual const Hittable* primitive() const override { return ptr->primitive(); }
 };
\ No newline at end of file
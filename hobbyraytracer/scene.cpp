@@ -10,6 +10,8 @@
 #include "scale.h"
 #include "sphere.h"
 
+#include <unordered_set>
+
 template<typename T>
 T Scene::getProperty(std::string name, YAML::Node node)
 {
@@ -70,6 +72,33 @@ glm::vec2 Scene::getProperty<glm::vec2>(std::string name, YAML::Node node)
     throw YAML::ParserException(node.Mark(), "Could not find required property: " + name);
 }
 
+// A file's modification time and size, read before the file itself so a write made meanwhile is
+// picked up on the next load
+static fileStamp stampFile(const std::string& path)
+{
+    fileStamp stamp;
+    std::error_code ec;
+
+    stamp.lastWrite = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        stamp.lastWrite = std::filesystem::file_time_type::min();
+
+    stamp.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        stamp.size = 0;
+
+    return stamp;
+}
+
+template<typename T>
+std::shared_ptr<Texture> Scene::readTexture(const std::string& name, const std::string& path)
+{
+    textureFiles[name] = { path, stampFile(path) };
+    textures[name] = std::make_shared<T>(path);
+
+    return textures[name];
+}
+
 template<>
 MatVec3 Scene::getProperty<MatVec3>(std::string name, YAML::Node node)
 {
@@ -87,8 +116,7 @@ MatVec3 Scene::getProperty<MatVec3>(std::string name, YAML::Node node)
                 return textures[textureName];
             }
             else {
-                textures[textureName] = std::make_shared<ImageTexture>(textureName);
-                return textures[textureName];
+                return readTexture<ImageTexture>(textureName, textureName);
             }
         }
     }
@@ -116,20 +144,64 @@ MatScalar Scene::getProperty<MatScalar>(std::string name, YAML::Node node)
             return textures[textureName];
         }
         else {
-            textures[textureName] = std::make_shared<ImageTexture>(textureName);
-            return textures[textureName];
+            return readTexture<ImageTexture>(textureName, textureName);
         }
     }
 
     throw YAML::ParserException(node.Mark(), "Could not find required property: " + name);
 }
 
-int Scene::loadScene(std::string path)
+int Scene::loadScene(std::string path, const Scene* previous)
 {
 	objects.clear();
 	materials.clear();
     textures.clear();
 
+    textureSources.clear();
+    materialSources.clear();
+    objectSources.clear();
+    meshes.clear();
+    textureFiles.clear();
+
+    // What changed since the previous load, anything depending on these is rebuilt too
+    std::unordered_set<std::string> changedTextures, changedMaterials;
+
+    // Unchanged objects from the previous load, by their YAML
+    std::unordered_map<std::string, std::vector<std::shared_ptr<Hittable>>> previousObjects;
+    if (previous)
+    {
+        for (const auto& [source, object] : previous->objectSources)
+        {
+            previousObjects[source].push_back(object);
+        }
+    }
+
+    // The previous load's import of a mesh file, if the file hasn't been written to since
+    auto unchangedMesh = [&](const std::string& file) -> const meshFile* {
+        if (!previous || !previous->meshes.count(file))
+            return nullptr;
+
+        const meshFile& last = previous->meshes.at(file);
+        return stampFile(file) == last.stamp ? &last : nullptr;
+    };
+
+    // Takes a texture from the previous load unless the file it was read from has changed since
+    auto reuseTexture = [&](const std::string& name) {
+        auto file = previous->textureFiles.find(name);
+        if (file != previous->textureFiles.end())
+        {
+            if (stampFile(file->second.path) != file->second.stamp)
+                return false;
+
+            textureFiles[name] = file->second;
+        }
+
+        textures[name] = previous->textures.at(name);
+        return true;
+    };
+
+    int rebuilt = 0, reused = 0;
+
     YAML::Node root;
 
     try {
@@ -139,13 +211,8 @@ int Scene::loadScene(std::string path)
 
         if (YAML::Node filmNode = root["film"])
         {
-            int w = getProperty<int>("width", filmNode);
-            int h = getProperty<int>("height", filmNode);
-            int samples = getProperty<int>("samples", filmNode);
-            std::string ouputPath = getProperty<std::string>("output", filmNode);
-
-            std::shared_ptr<Film> f = std::make_shared<Film>(w, h, samples, ouputPath);
-            film = f;
+            baseFilm = YAML::Clone(filmNode);
+            film = parseFilm(baseFilm);
         }
         else 
         {
@@ -155,15 +222,8 @@ int Scene::loadScene(std::string path)
 
         if (YAML::Node cameraNode = root["camera"])
         {
-            glm::vec3 position = getProperty<glm::vec3>("position", cameraNode);
-            glm::vec3 lookAt = getProperty<glm::vec3>("look_at", cameraNode);
-            glm::vec3 up = getProperty<glm::vec3>("up", cameraNode);
-            float fov = getProperty<float>("fov", cameraNode);
-            float aperture = getProperty<float>("aperture", cameraNode);
-            float focusDistance = getProperty<float>("focal_distance", cameraNode);
-
-            Camera c(position, lookAt, up, fov, film->getAspectRatio(), aperture, focusDistance);
-            camera = c;
+            baseCamera = YAML::Clone(cameraNode);
+            camera = parseCamera(baseCamera, film->getAspectRatio());
         }
         else
         {
@@ -171,6 +231,12 @@ int Scene::loadScene(std::string path)
             return -1;
         }
 
+        integrator = parseIntegrator(root["integrator"]);
+        sampler = parseSampler(root["sampler"], film->getFilm().samples);
+
+        batchCameras = root["cameras"] ? YAML::Clone(root["cameras"]) : YAML::Node();
+        cameraPath = root["camera_path"] ? YAML::Clone(root["camera_path"]) : YAML::Node();
+
         if (YAML::Node texturesNode = root["textures"])
         {
             for (auto texture : texturesNode)
@@ -181,6 +247,19 @@ int Scene::loadScene(std::string path)
                     throw YAML::ParserException(texture.Mark(), "Texture name already exists!");
                 }
 
+                std::string source = YAML::Dump(texture);
+                textureSources[name] = source;
+
+                if (previous && previous->textureSources.count(name) && previous->textureSources.at(name) == source
+                    && reuseTexture(name))
+                {
+                    reused++;
+                    continue;
+                }
+
+                changedTextures.insert(name);
+                rebuilt++;
+
                 if (getProperty<std::string>("type", texture) == "solid")
                 {
                     glm::vec3 colour = getProperty<glm::vec3>("colour", texture);
@@ -192,7 +271,7 @@ int Scene::loadScene(std::string path)
                 {
                     std::string path = getProperty<std::string>("path", texture);
 
-                    textures[name] = std::make_shared<ImageTexture>(path);
+                    readTexture<ImageTexture>(name, path);
                 }
 
                 if (getProperty<std::string>("type", texture) == "checkered")
@@ -207,11 +286,22 @@ int Scene::loadScene(std::string path)
                 {
                     std::string path = getProperty<std::string>("path", texture);
 
-                    textures[name] = std::make_shared<EnvironmentMap>(path);
+                    readTexture<EnvironmentMap>(name, path);
                 }
             }
         }
 
+        // Textures named by path straight from a material or the background, rather than declared
+        // above. One whose file has changed is read again by whatever uses it, which is rebuilt.
+        if (previous)
+        {
+            for (const auto& [name, texture] : previous->textures)
+            {
+                if (!previous->textureSources.count(name) && !textures.count(name) && !reuseTexture(name))
+                    changedTextures.insert(name);
+            }
+        }
+
         if (YAML::Node bg = root["camera"]["background"])
         {
             if (bg.IsSequence())
@@ -226,8 +316,7 @@ int Scene::loadScene(std::string path)
                     background = textures[textureName];
                 }
                 else {
-                    textures[textureName] = std::make_shared<EnvironmentMap>(textureName);
-                    background = textures[textureName];
+                    background = readTexture<EnvironmentMap>(textureName, textureName);
                 }
             }
         }
@@ -241,6 +330,33 @@ int Scene::loadScene(std::string path)
             for (auto material : materialsNode)
             {
                 std::string name = getProperty<std::string>("name", material);
+
+                std::string source = YAML::Dump(material);
+                materialSources[name] = source;
+
+                bool texturesChanged = std::any_of(material.begin(), material.end(), [&](const auto& property) {
+                    return property.second.IsScalar() && changedTextures.count(property.second.template as<std::string>()) > 0;
+                });
+
+                if (previous && !texturesChanged && previous->materialSources.count(name) && previous->materialSources.at(name) == source)
+                {
+                    materials[name] = previous->materials.at(name);
+                    reused++;
+                    continue;
+                }
+
+                changedMaterials.insert(name);
+                rebuilt++;
+
+                // Glass has no albedo, it passes or reflects everything
+                if (getProperty<std::string>("type", material) == "dielectric")
+                {
+                    MatScalar ior = getProperty<MatScalar>("ior", material);
+                    MatScalar roughness = material["roughness"] ? getProperty<MatScalar>("roughness", material) : MatScalar(0.0f);
+                    materials[name] = std::make_shared<Dielectric>(ior, roughness);
+                    continue;
+                }
+
                 MatVec3 albedo = getProperty<MatVec3>("albedo", material);
 
                 if (getProperty<std::string>("type", material) == "diffuse_light")
@@ -269,6 +385,8 @@ int Scene::loadScene(std::string path)
             std::cout << "Couldn't find any material descriptors!" << std::endl;
         }
 
+        lights = std::make_shared<LightList>();
+
         if (YAML::Node objectsNode = root["objects"])
         {
             if (objectsNode.IsSequence())
@@ -289,11 +407,55 @@ int Scene::loadScene(std::string path)
                         continue;
                     }
 
-                    if (getProperty<std::string>("type", object) == "mesh")
+                    std::string source = YAML::Dump(object);
+
+                    // A mesh is only unchanged if the file it was imported from is too
+                    bool isMesh = getProperty<std::string>("type", object) == "mesh";
+                    std::string meshPath = isMesh ? getProperty<std::string>("path", object) : std::string();
+                    const meshFile* lastMesh = isMesh ? unchangedMesh(meshPath) : nullptr;
+
+                    auto unchanged = previousObjects.find(source);
+                    if (unchanged != previousObjects.end() && !unchanged->second.empty() && !changedMaterials.count(materialKey)
+                        && (!isMesh || lastMesh))
                     {
-                        std::string path = getProperty<std::string>("path", object);
+                        o = unchanged->second.back();
+                        unchanged->second.pop_back();
+
+                        if (isMesh)
+                            meshes.emplace(meshPath, *lastMesh);
 
-                        o = std::make_shared<Mesh>(path, m);
+                        objects.add(o);
+                        objectSources.push_back({ source, o });
+                        if (m->isEmissive()) lights->add(o, m);
+                        reused++;
+                        continue;
+                    }
+
+                    rebuilt++;
+
+                    if (isMesh)
+                    {
+                        // The triangles and BVH are shared with any other use of the same file, in this
+                        // load or the last, so a new material or transform doesn't mean importing it again
+                        std::shared_ptr<Mesh> mesh;
+
+                        if (meshes.count(meshPath))
+                        {
+                            mesh = std::make_shared<Mesh>(*meshes[meshPath].mesh, m);
+                        }
+                        else if (lastMesh)
+                        {
+                            mesh = std::make_shared<Mesh>(*lastMesh->mesh, m);
+                            meshes[meshPath] = *lastMesh;
+                        }
+                        else
+                        {
+                            fileStamp stamp = stampFile(meshPath);
+                            mesh = std::make_shared<Mesh>(meshPath, m, buildSeed);
+                            meshes[meshPath] = { mesh, stamp };
+                        }
+
+                        o = mesh;
                     }
 
                     if (getProperty<std::string>("type", object) == "sphere")
@@ -354,6 +516,8 @@ int Scene::loadScene(std::string path)
                     }
 
                     objects.add(o);
+                    objectSources.push_back({ source, o });
+                    if (m->isEmissive()) lights->add(o, m);
                 }
             }
         }
@@ -362,12 +526,36 @@ int Scene::loadScene(std::string path)
             std::cout << "Couldn't find any object descriptors!" << std::endl;
         }
 
+        AABB bounds;
+        bool bounded = objects.boundingBox(bounds);
+
+        if (auto environment = std::dynamic_pointer_cast<EnvironmentMap>(background))
+        {
+            float radius = 1.0f;
+
+            if (bounded)
+                radius = glm::max(0.5f * glm::length(bounds.getMax() - bounds.getMin()), 1e-3f);
+
+            lights->setEnvironment(environment, radius);
+        }
+
+        if (bounded)
+            integrator->prepare(bounds);
+
+        lights->build();
+
     }
     catch (const YAML::Exception& ex) {
         std::cout << ex.what() << std::endl;
         return -1;
     }
 
+    if (previous)
+    {
+        std::cout << "Reloaded scene: " << path << ", rebuilt " << rebuilt << " and reused " << reused
+            << " textures, materials and objects" << std::endl;
+    }
+
     isLoaded = true;
 
     return 1;
@@ -377,3 +565,315 @@ std::shared_ptr<HittableList> Scene::getScene()
 {
     return std::make_shared<HittableList>(objects);
 }
+
+std::vector<std::filesystem::path> Scene::getInputFiles() const
+{
+    std::vector<std::filesystem::path> files;
+
+    for (const auto& [path, file] : meshes)
+        files.push_back(path);
+
+    for (const auto& [name, file] : textureFiles)
+        files.push_back(file.path);
+
+    return files;
+}
+
+std::shared_ptr<Film> Scene::parseFilm(YAML::Node filmNode)
+{
+    film_desc desc;
+    desc.dimensions.x = getProperty<int>("width", filmNode);
+    desc.dimensions.y = getProperty<int>("height", filmNode);
+    desc.samples = getProperty<int>("samples", filmNode);
+    std::string ouputPath = getProperty<std::string>("output", filmNode);
+
+    if (filmNode["tile_size"])
+        desc.tileSize = getProperty<int>("tile_size", filmNode);
+
+    if (filmNode["threads"])
+        desc.threads = getProperty<int>("threads", filmNode);
+
+    if (filmNode["time_limit"])
+        desc.timeLimit = getProperty<float>("time_limit", filmNode);
+
+    if (filmNode["samples_per_pass"])
+        desc.samplesPerPass = getProperty<int>("samples_per_pass", filmNode);
+
+    if (filmNode["progressive"])
+        desc.progressive = getProperty<bool>("progressive", filmNode);
+
+    if (filmNode["flush_passes"])
+        desc.flushPasses = getProperty<int>("flush_passes", filmNode);
+
+    if (filmNode["flush_seconds"])
+        desc.flushSeconds = getProperty<float>("flush_seconds", filmNode);
+
+    if (filmNode["adaptive"])
+        desc.adaptive = getProperty<bool>("adaptive", filmNode);
+
+    if (filmNode["adaptive_threshold"])
+        desc.adaptiveThreshold = getProperty<float>("adaptive_threshold", filmNode);
+
+    if (filmNode["min_samples"])
+        desc.minSamples = getProperty<int>("min_samples", filmNode);
+
+    return std::make_shared<Film>(desc, ouputPath);
+}
+
+std::shared_ptr<Integrator> Scene::parseIntegrator(YAML::Node integratorNode)
+{
+    path_desc desc;
+    std::string type = "path";
+
+    if (integratorNode)
+    {
+        if (integratorNode["type"])
+            type = getProperty<std::string>("type", integratorNode);
+
+        if (integratorNode["max_depth"])
+            desc.maxDepth = getProperty<int>("max_depth", integratorNode);
+
+        // The per kind limits default to max_depth, i.e. no extra limit
+        desc.diffuseDepth = desc.glossyDepth = desc.transmissionDepth = desc.maxDepth;
+
+        if (integratorNode["diffuse_depth"])
+            desc.diffuseDepth = getProperty<int>("diffuse_depth", integratorNode);
+
+        if (integratorNode["glossy_depth"])
+            desc.glossyDepth = getProperty<int>("glossy_depth", integratorNode);
+
+        if (integratorNode["transmission_depth"])
+            desc.transmissionDepth = getProperty<int>("transmission_depth", integratorNode);
+
+        if (integratorNode["rr_depth"])
+            desc.rouletteDepth = getProperty<int>("rr_depth", integratorNode);
+
+        if (desc.maxDepth < 1)
+            throw YAML::ParserException(integratorNode.Mark(), "max_depth must be at least 1");
+    }
+
+    if (type == "path")
+        return std::make_shared<PathIntegrator>(desc);
+
+    if (type == "nee")
+        return std::make_shared<NEEIntegrator>(desc);
+
+    if (type == "mis")
+        return std::make_shared<MISIntegrator>(desc);
+
+    if (type == "bdpt")
+        return std::make_shared<BDPTIntegrator>(desc);
+
+    if (type == "guided")
+    {
+        guiding_desc guiding;
+
+        if (integratorNode["training_samples"])
+            guiding.trainingSamples = getProperty<int>("training_samples", integratorNode);
+
+        if (integratorNode["bsdf_fraction"])
+            guiding.bsdfFraction = getProperty<float>("bsdf_fraction", integratorNode);
+
+        if (integratorNode["memory_limit"])
+            guiding.memoryLimit = (size_t)getProperty<int>("memory_limit", integratorNode) << 20;
+
+        // With no BSDF samples, directions the guide hasn't learned about could never be reached
+        if (guiding.bsdfFraction <= 0.0f || guiding.bsdfFraction > 1.0f)
+            throw YAML::ParserException(integratorNode.Mark(), "bsdf_fraction must be above 0 and at most 1");
+
+        return std::make_shared<GuidedIntegrator>(desc, guiding);
+    }
+
+    if (type == "photon")
+    {
+        photon_desc photons;
+
+        if (integratorNode["photons"])
+            photons.count = getProperty<int>("photons", integratorNode);
+
+        if (integratorNode["radius"])
+            photons.radius = getProperty<float>("radius", integratorNode);
+
+        if (integratorNode["progressive"])
+            photons.progressive = getProperty<bool>("progressive", integratorNode);
+
+        if (photons.count < 1)
+            throw YAML::ParserException(integratorNode.Mark(), "photons must be at least 1");
+
+        return std::make_shared<PhotonIntegrator>(desc, photons);
+    }
+
+    if (type == "cached")
+    {
+        cache_desc caching;
+
+        if (integratorNode["cell_size"])
+            caching.cellSize = getProperty<float>("cell_size", integratorNode);
+
+        if (integratorNode["training_fraction"])
+            caching.trainingFraction = getProperty<float>("training_fraction", integratorNode);
+
+        if (integratorNode["cell_samples"])
+            caching.cellSamples = getProperty<int>("cell_samples", integratorNode);
+
+        // With no training paths the cache would never fill
+        if (caching.trainingFraction <= 0.0f || caching.trainingFraction > 1.0f)
+            throw YAML::ParserException(integratorNode.Mark(), "training_fraction must be above 0 and at most 1");
+
+        return std::make_shared<CachedIntegrator>(desc, caching);
+    }
+
+    throw YAML::ParserException(integratorNode.Mark(), "Unknown integrator type: " + type);
+}
+
+sampler_desc Scene::parseSampler(YAML::Node samplerNode, int samples)
+{
+    sampler_desc desc;
+    desc.samples = samples;
+
+    if (samplerNode && samplerNode["type"])
+    {
+        std::string type = getProperty<std::string>("type", samplerNode);
+
+        if (type == "independent")
+            desc.type = SamplerType::Independent;
+        else if (type == "sobol")
+            desc.type = SamplerType::Sobol;
+        else if (type == "stratified")
+            desc.type = SamplerType::Stratified;
+        else if (type == "blue_noise")
+            desc.type = SamplerType::BlueNoise;
+        else
+            throw YAML::ParserException(samplerNode.Mark(), "Unknown sampler type: " + type);
+    }
+
+    return desc;
+}
+
+Camera Scene::parseCamera(YAML::Node cameraNode, float aspectRatio)
+{
+    glm::vec3 position = getProperty<glm::vec3>("position", cameraNode);
+    glm::vec3 lookAt = getProperty<glm::vec3>("look_at", cameraNode);
+    glm::vec3 up = getProperty<glm::vec3>("up", cameraNode);
+    float fov = getProperty<float>("fov", cameraNode);
+    float aperture = getProperty<float>("aperture", cameraNode);
+    float focusDistance = getProperty<float>("focal_distance", cameraNode);
+
+    return Camera(position, lookAt, up, fov, aspectRatio, aperture, focusDistance);
+}
+
+// Copies node, with every key in overrides replacing the original
+static YAML::Node mergeNodes(const YAML::Node& node, const YAML::Node& overrides)
+{
+    YAML::Node merged = YAML::Clone(node);
+
+    if (overrides && overrides.IsMap())
+    {
+        for (auto entry : overrides)
+        {
+            merged[entry.first.as<std::string>()] = YAML::Clone(entry.second);
+        }
+    }
+
+    return merged;
+}
+
+std::shared_ptr<Film> Scene::createFilm(const YAML::Node& overrides)
+{
+    assert(isLoaded);
+    return parseFilm(mergeNodes(baseFilm, overrides));
+}
+
+Camera Scene::createCamera(const YAML::Node& overrides, float aspectRatio)
+{
+    assert(isLoaded);
+    return parseCamera(mergeNodes(baseCamera, overrides), aspectRatio);
+}
+
+// Linear blend of two camera properties, numbers and lists of numbers are interpolated,
+// anything else holds the first keyframe's value
+static YAML::Node lerpNodes(const YAML::Node& a, const YAML::Node& b, float t)
+{
+    try {
+        if (a.IsScalar() && b.IsScalar())
+        {
+            return YAML::Node(glm::mix(a.as<float>(), b.as<float>(), t));
+        }
+
+        if (a.IsSequence() && b.IsSequence() && a.size() == b.size())
+        {
+            YAML::Node result;
+            for (size_t i = 0; i < a.size(); i++)
+            {
+                result.push_back(glm::mix(a[i].as<float>(), b[i].as<float>(), t));
+            }
+
+            return result;
+        }
+    }
+    catch (const YAML::Exception&) {
+
+    }
+
+    return YAML::Clone(a);
+}
+
+std::vector<Camera> Scene::createBatchCameras(float aspectRatio)
+{
+    assert(isLoaded);
+
+    std::vector<Camera> cameras;
+
+    if (batchCameras)
+    {
+        for (auto cameraNode : batchCameras)
+        {
+            cameras.push_back(createCamera(cameraNode, aspectRatio));
+        }
+    }
+
+    if (cameraPath)
+    {
+        int frames = getProperty<int>("frames", cameraPath);
+        YAML::Node keyframes = getProperty<YAML::Node>("keyframes", cameraPath);
+
+        std::vector<YAML::Node> keys(keyframes.begin(), keyframes.end());
+        std::stable_sort(keys.begin(), keys.end(), [this](const YAML::Node& a, const YAML::Node& b) {
+            return getProperty<float>("frame", a) < getProperty<float>("frame", b);
+        });
+
+        if (keys.empty())
+            throw YAML::ParserException(cameraPath.Mark(), "Camera path needs at least one keyframe");
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            // The keyframes either side of this frame, the path holds still before the first and after the last
+            size_t next = 0;
+            while (next < keys.size() && getProperty<float>("frame", keys[next]) <= frame)
+            {
+                next++;
+            }
+
+            const YAML::Node& a = keys[next > 0 ? next - 1 : 0];
+            const YAML::Node& b = keys[next < keys.size() ? next : keys.size() - 1];
+
+            float fa = getProperty<float>("frame", a);
+            float fb = getProperty<float>("frame", b);
+            float t = fb > fa ? glm::clamp((frame - fa) / (fb - fa), 0.0f, 1.0f) : 0.0f;
+
+            YAML::Node overrides;
+            for (auto entry : a)
+            {
+                std::string key = entry.first.as<std::string>();
+                if (key == "frame")
+                    continue;
+
+                overrides[key] = b[key] ? lerpNodes(entry.second, b[key], t) : YAML::Clone(entry.second);
+            }
+
+            cameras.push_back(createCamera(overrides, aspectRatio));
+        }
+    }
+
+    return cameras;
+}
\ No newline at end of file
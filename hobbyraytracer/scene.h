@@ -7,9 +7,35 @@
 #include "mesh.h"	
 #include "camera.h"
 #include "film.h"
+#include "lights.h"
+#include "integrator.h"
+#include "sampler.h"
 
 #include <yaml-cpp/yaml.h>
 
+// What a file looked like when it was read, to tell on the next load whether it has changed
+struct fileStamp
+{
+	std::filesystem::file_time_type lastWrite;
+	std::uintmax_t size = 0;
+
+	bool operator==(const fileStamp& other) const = default;
+};
+
+// A mesh file's geometry, and its file as it was imported
+struct meshFile
+{
+	std::shared_ptr<Mesh> mesh;
+	fileStamp stamp;
+};
+
+// An image or environment map's file as it was read
+struct textureFile
+{
+	std::string path;
+	fileStamp stamp;
+};
+
 class Scene
 {
 private:
@@ -21,20 +47,74 @@ private:
 	std::shared_ptr<Texture> background;
 	std::shared_ptr<Film> film;
 
+	std::shared_ptr<LightList> lights;
+	std::shared_ptr<Integrator> integrator;
+	sampler_desc sampler;
+
 public:
 	Scene() : isLoaded(false) { }
 
-	int loadScene(std::string path);
+	// With previous, any texture, material or object whose YAML hasn't changed since previous was
+	// loaded is taken from it rather than built again, along with the geometry of every mesh file
+	// that hasn't been written to since
+	int loadScene(std::string path, const Scene* previous = nullptr);
+
+	// Build acceleration structures reproducibly from the given seed
+	void setDeterministic(uint64_t seed) { buildSeed = seed; }
+
+	// Render with other's integrator in place of this scene's own, so copies of one scene share
+	// whatever it traces or learns between passes
+	void shareIntegrator(const Scene& other) { integrator = other.integrator; }
 
 	std::shared_ptr<HittableList> getScene();
 
+	// The mesh and texture files the scene was built from, to watch along with the scene file
+	std::vector<std::filesystem::path> getInputFiles() const;
+
 	const Camera& getCamera() { assert(isLoaded); return camera; }
 	const std::shared_ptr<Texture>& getBackground() { assert(isLoaded); return background; }
 	const std::shared_ptr<Film>& getFilm() { assert(isLoaded); return film; }
+	const std::shared_ptr<LightList>& getLights() { assert(isLoaded); return lights; }
+	const std::shared_ptr<Integrator>& getIntegrator() { assert(isLoaded); return integrator; }
+	const sampler_desc& getSampler() { assert(isLoaded); return sampler; }
+
+	// A new film or camera with the scene file's settings, except for anything given in overrides,
+	// e.g. { width: 320, samples: 4 }. Throws YAML::Exception if the result is invalid.
+	std::shared_ptr<Film> createFilm(const YAML::Node& overrides);
+	Camera createCamera(const YAML::Node& overrides, float aspectRatio);
+
+	// Every camera described for a batch render: each entry of "cameras", then each frame of
+	// "camera_path" interpolated between its keyframes. Empty if the scene has neither.
+	std::vector<Camera> createBatchCameras(float aspectRatio);
 
 private:
 	template<typename T>
 	T getProperty(std::string name, YAML::Node node);
 
+	std::shared_ptr<Film> parseFilm(YAML::Node filmNode);
+	Camera parseCamera(YAML::Node cameraNode, float aspectRatio);
+	std::shared_ptr<Integrator> parseIntegrator(YAML::Node integratorNode);
+	sampler_desc parseSampler(YAML::Node samplerNode, int samples);
+
+	// A texture of type T (ImageTexture or EnvironmentMap) read from path, noting what the file was like
+	template<typename T>
+	std::shared_ptr<Texture> readTexture(const std::string& name, const std::string& path);
+
+	// As written in the scene file, kept so they can be re-parsed with overrides
+	YAML::Node baseFilm;
+	YAML::Node baseCamera;
+	YAML::Node batchCameras;
+	YAML::Node cameraPath;
+
+	// The YAML everything was built from, to tell what has changed on the next load
+	std::unordered_map<std::string, std::string> textureSources;
+	std::unordered_map<std::string, std::string> materialSources;
+	std::vector<std::pair<std::string, std::shared_ptr<Hittable>>> objectSources;
+
+	std::unordered_map<std::string, meshFile> meshes; // By file path
+	std::unordered_map<std::string, textureFile> textureFiles; // By texture name, for those read from a file
+
 	bool isLoaded;
+
+	std::optional<uint64_t> buildSeed;
 };
\ No newline at end of file
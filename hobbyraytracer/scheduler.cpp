@@ -0,0 +1,193 @@
+#include "hobbyraytracer.h"
+#include "scheduler.h"
+
+TileScheduler::TileScheduler(glm::ivec2 dimensions, int tileSize, int nThreads, std::function<void(int worker)> workerInit)
+	: tiles(split(dimensions, tileSize)), numThreads(glm::max(nThreads, 1))
+{
+	for (int i = 0; i < numThreads; i++)
+	{
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	workers.reserve(numThreads);
+
+	for (int w = 0; w < numThreads; w++)
+	{
+		workers.emplace_back(&TileScheduler::work, this, w, workerInit);
+	}
+}
+
+TileScheduler::~TileScheduler()
+{
+	{
+		std::lock_guard<std::mutex> guard(poolMutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+std::vector<Tile> TileScheduler::split(glm::ivec2 dimensions, int tileSize)
+{
+	std::vector<Tile> tiles;
+
+	tileSize = glm::max(tileSize, 1);
+
+	glm::ivec2 count(
+		(dimensions.x + tileSize - 1) / tileSize,
+		(dimensions.y + tileSize - 1) / tileSize
+	);
+
+	for (const glm::ivec2& t : spiralOrder(count))
+	{
+		Tile tile;
+		tile.min = glm::ivec2(t.x * tileSize, t.y * tileSize);
+		tile.max = glm::ivec2(
+			glm::min(tile.min.x + tileSize, dimensions.x),
+			glm::min(tile.min.y + tileSize, dimensions.y)
+		);
+		tile.index = static_cast<int>(tiles.size());
+
+		tiles.push_back(tile);
+	}
+
+	return tiles;
+}
+
+void TileScheduler::run(const std::function<void(int worker, const Tile& tile)>& renderTile)
+{
+	// Deal the spiral out in contiguous runs so neighbouring tiles share a worker
+	for (auto& q : queues)
+	{
+		q->tiles.clear();
+	}
+
+	size_t perWorker = glm::max<size_t>((tiles.size() + numThreads - 1) / numThreads, 1);
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		queues[i / perWorker]->tiles.push_back(static_cast<int>(i));
+	}
+
+	std::unique_lock<std::mutex> lock(poolMutex);
+
+	pass = &renderTile;
+	busy = numThreads;
+	generation++;
+
+	wake.notify_all();
+	done.wait(lock, [this]() { return busy == 0; });
+
+	pass = nullptr;
+}
+
+void TileScheduler::work(int worker, std::function<void(int worker)> workerInit)
+{
+	if (workerInit)
+		workerInit(worker);
+
+	uint64_t seen = 0;
+
+	while (true)
+	{
+		const std::function<void(int worker, const Tile& tile)>* renderTile;
+
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			wake.wait(lock, [&]() { return stopping || generation != seen; });
+
+			if (stopping)
+				return;
+
+			seen = generation;
+			renderTile = pass;
+		}
+
+		int tile;
+		while (pop(worker, tile) || steal(worker, tile))
+		{
+			(*renderTile)(worker, tiles[tile]);
+		}
+
+		std::lock_guard<std::mutex> guard(poolMutex);
+		if (--busy == 0)
+			done.notify_one();
+	}
+}
+
+bool TileScheduler::pop(int worker, int& tile)
+{
+	WorkQueue& q = *queues[worker];
+
+	std::lock_guard<std::mutex> guard(q.m);
+	if (q.tiles.empty())
+		return false;
+
+	tile = q.tiles.front();
+	q.tiles.pop_front();
+
+	return true;
+}
+
+bool TileScheduler::steal(int thief, int& tile)
+{
+	// Start with the next worker along so thieves don't all pile onto worker 0
+	for (int i = 1; i < numThreads; i++)
+	{
+		WorkQueue& q = *queues[(thief + i) % numThreads];
+
+		std::lock_guard<std::mutex> guard(q.m);
+		if (q.tiles.empty())
+			continue;
+
+		tile = q.tiles.back();
+		q.tiles.pop_back();
+
+		return true;
+	}
+
+	return false;
+}
+
+std::vector<glm::ivec2> TileScheduler::spiralOrder(glm::ivec2 count)
+{
+	std::vector<glm::ivec2> order;
+	order.reserve(count.x * count.y);
+
+	// Walk an expanding square spiral around the centre tile (1 right, 1 down, 2 left, 2 up, 3 right...)
+	// and keep whichever steps land inside the grid
+	glm::ivec2 p((count.x - 1) / 2, (count.y - 1) / 2);
+	const glm::ivec2 directions[4] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+	int run = 1;
+	int direction = 0;
+
+	auto visit = [&](glm::ivec2 t) {
+		if (t.x >= 0 && t.y >= 0 && t.x < count.x && t.y < count.y)
+			order.push_back(t);
+	};
+
+	visit(p);
+
+	while (order.size() < static_cast<size_t>(count.x * count.y))
+	{
+		for (int leg = 0; leg < 2; leg++)
+		{
+			for (int step = 0; step < run; step++)
+			{
+				p = p + directions[direction];
+				visit(p);
+			}
+
+			direction = (direction + 1) % 4;
+		}
+
+		run++;
+	}
+
+	return order;
+}
\ No newline at end of file
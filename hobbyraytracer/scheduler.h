@@ -0,0 +1,76 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// A rectangular block of pixels, [min, max) in film coordinates
+struct Tile
+{
+	glm::ivec2 min;
+	glm::ivec2 max;
+
+	int index;
+
+	int area() const { return (max.x - min.x) * (max.y - min.y); }
+};
+
+// Splits the film into tiles and renders them on a fixed pool of worker threads, started once
+// and kept asleep between passes rather than spawned again for each one. Tiles are ordered
+// along a spiral out from the centre of the image, so the interesting part of the frame
+// finishes first, and are dealt out in contiguous runs to per-worker deques. A worker takes
+// from the front of its own deque and, once that is empty, steals from the back of someone
+// else's - so cheap sky tiles and expensive glass tiles even out.
+class TileScheduler
+{
+public:
+	// workerInit is called once on each worker thread before it takes any tiles, e.g. to pin
+	// it to a core
+	TileScheduler(glm::ivec2 dimensions, int tileSize, int numThreads, std::function<void(int worker)> workerInit = nullptr);
+	~TileScheduler();
+
+	TileScheduler(const TileScheduler&) = delete;
+	TileScheduler& operator=(const TileScheduler&) = delete;
+
+	// Render every tile exactly once, blocks until all workers have finished
+	void run(const std::function<void(int worker, const Tile& tile)>& renderTile);
+
+	int getNumThreads() const { return numThreads; }
+	const std::vector<Tile>& getTiles() const { return tiles; }
+
+	// The tiles a scheduler would split a film into, in the order it deals them out
+	static std::vector<Tile> split(glm::ivec2 dimensions, int tileSize);
+
+private:
+	struct WorkQueue
+	{
+		std::mutex m;
+		std::deque<int> tiles;
+	};
+
+	void work(int worker, std::function<void(int worker)> workerInit);
+
+	bool pop(int worker, int& tile);
+	bool steal(int thief, int& tile);
+
+	static std::vector<glm::ivec2> spiralOrder(glm::ivec2 count);
+
+private:
+	std::vector<Tile> tiles;
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	std::vector<std::thread> workers;
+
+	// Hands a pass to the sleeping workers: run() bumps the generation and waits for busy to
+	// drop back to 0
+	std::mutex poolMutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	const std::function<void(int worker, const Tile& tile)>* pass = nullptr;
+	uint64_t generation = 0;
+	int busy = 0;
+	bool stopping = false;
+
+	int numThreads;
+};
\ No newline at end of file
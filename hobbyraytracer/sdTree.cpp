@@ -0,0 +1,321 @@
+#include "hobbyraytracer.h"
+#include "sdTree.h"
+
+// 16 fractional bits are plenty for a sampling distribution, and leave room for ~10^14 of flux per tree
+constexpr double GUIDING_FIXED_POINT_SCALE = 1 << 16;
+
+// A single sample can't claim more than this, so one firefly can't overflow a cell or take over the guide
+constexpr float MAX_RECORDED_FLUX = 1e6f;
+
+// Scattered directions aren't always unit length, so this normalises its own
+static glm::vec2 directionToSquare(const glm::vec3& direction)
+{
+	glm::vec3 d = glm::normalize(direction);
+
+	float cosTheta = glm::clamp(d.z, -1.0f, 1.0f);
+	float phi = std::atan2(d.y, d.x);
+
+	if (phi < 0.0f)
+		phi += 2.0f * glm::pi<float>();
+
+	glm::vec2 p((cosTheta + 1.0f) * 0.5f, phi / (2.0f * glm::pi<float>()));
+
+	return glm::clamp(p, glm::vec2(0.0f), glm::vec2(0x1.fffffep-1f));
+}
+
+static glm::vec3 squareToDirection(const glm::vec2& p)
+{
+	float cosTheta = 2.0f * p.x - 1.0f;
+	float sinTheta = std::sqrt(glm::max(1.0f - cosTheta * cosTheta, 0.0f));
+	float phi = 2.0f * glm::pi<float>() * p.y;
+
+	return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+// Which quadrant p is in, and p rescaled to that quadrant
+static int descend(glm::vec2& p)
+{
+	int x = p.x >= 0.5f;
+	int y = p.y >= 0.5f;
+
+	p = p * 2.0f - glm::vec2(x, y);
+
+	return x + 2 * y;
+}
+
+DTree::DTree() : nodes(1) { }
+
+double DTree::sum(const quadNode& node)
+{
+	return (double)(node.flux[0] + node.flux[1] + node.flux[2] + node.flux[3]);
+}
+
+double DTree::total() const
+{
+	return sum(nodes[0]);
+}
+
+void DTree::clear()
+{
+	for (quadNode& node : nodes)
+	{
+		node.flux = {};
+		node.samples = {};
+	}
+
+	samples = 0;
+}
+
+void DTree::record(const glm::vec3& direction, float flux)
+{
+	int64_t fixed = static_cast<int64_t>(std::llround(glm::clamp(flux, 0.0f, MAX_RECORDED_FLUX) * GUIDING_FIXED_POINT_SCALE));
+
+	// Only the leaf is touched, so workers aren't all contending for the top of the tree.
+	// sumUp() fills in the levels above once the iteration is over.
+	glm::vec2 p = directionToSquare(direction);
+	int node = 0;
+	int q = descend(p);
+
+	while (nodes[node].children[q])
+	{
+		node = nodes[node].children[q];
+		q = descend(p);
+	}
+
+	// The count sits next to the flux, so it doesn't cost another cache line
+	std::atomic_ref<uint64_t>(nodes[node].samples[q]).fetch_add(1, std::memory_order_relaxed);
+
+	if (fixed != 0)
+		std::atomic_ref<int64_t>(nodes[node].flux[q]).fetch_add(fixed, std::memory_order_relaxed);
+}
+
+void DTree::sumUp()
+{
+	samples = 0;
+
+	// Children always come after their parents
+	for (int i = (int)nodes.size() - 1; i >= 0; i--)
+	{
+		for (int q = 0; q < 4; q++)
+		{
+			if (!nodes[i].children[q])
+			{
+				samples += nodes[i].samples[q];
+				continue;
+			}
+
+			const std::array<int64_t, 4>& flux = nodes[nodes[i].children[q]].flux;
+			nodes[i].flux[q] = flux[0] + flux[1] + flux[2] + flux[3];
+		}
+	}
+}
+
+glm::vec3 DTree::sample(Sampler& sampler) const
+{
+	glm::vec2 u(sampler.nextFloat(), sampler.nextFloat());
+
+	glm::vec2 corner(0.0f);
+	float size = 1.0f;
+	int node = 0;
+
+	// Pick a column then a row within it in proportion to flux, reusing what's left of u each level
+	while (true)
+	{
+		const std::array<int64_t, 4>& flux = nodes[node].flux;
+
+		float left = (float)((double)(flux[0] + flux[2]) / sum(nodes[node]));
+		int x = u.x >= left;
+		u.x = x ? (u.x - left) / (1.0f - left) : u.x / left;
+
+		float bottom = (float)((double)flux[x] / (double)(flux[x] + flux[x + 2]));
+		int y = u.y >= bottom;
+		u.y = y ? (u.y - bottom) / (1.0f - bottom) : u.y / bottom;
+
+		u = glm::clamp(u, glm::vec2(0.0f), glm::vec2(0x1.fffffep-1f));
+
+		size *= 0.5f;
+		corner += glm::vec2(x, y) * size;
+
+		int child = nodes[node].children[x + 2 * y];
+		if (!child)
+			break;
+
+		node = child;
+	}
+
+	return squareToDirection(corner + u * size);
+}
+
+float DTree::pdf(const glm::vec3& direction) const
+{
+	if (!canSample())
+		return 0.0f;
+
+	glm::vec2 p = directionToSquare(direction);
+	float density = 1.0f;
+	int node = 0;
+
+	while (true)
+	{
+		int q = descend(p);
+		double nodeTotal = sum(nodes[node]);
+
+		if (nodeTotal <= 0.0)
+			return 0.0f;
+
+		density *= (float)(4.0 * nodes[node].flux[q] / nodeTotal);
+
+		if (!nodes[node].children[q])
+			break;
+
+		node = nodes[node].children[q];
+	}
+
+	return density / (4.0f * glm::pi<float>());
+}
+
+DTree DTree::refined(float threshold, int maxDepth) const
+{
+	DTree result;
+
+	double all = total();
+	if (all <= 0.0)
+		return result;
+
+	// A quadrant of the old tree (or a piece of an old leaf, with its flux shared out evenly)
+	// that's becoming node target of the new one
+	struct cell
+	{
+		int oldNode; // -1 past the old tree's leaves
+		double flux;
+		int target;
+		int depth;
+	};
+
+	std::vector<cell> stack = { { 0, all, 0, 1 } };
+
+	while (!stack.empty())
+	{
+		cell c = stack.back();
+		stack.pop_back();
+
+		for (int q = 0; q < 4; q++)
+		{
+			double quadrantFlux = c.oldNode >= 0 ? (double)nodes[c.oldNode].flux[q] : c.flux / 4.0;
+
+			if (quadrantFlux / all <= threshold || c.depth >= maxDepth)
+				continue;
+
+			int child = (int)result.nodes.size();
+			result.nodes.emplace_back();
+			result.nodes[c.target].children[q] = child;
+
+			int oldChild = c.oldNode >= 0 && nodes[c.oldNode].children[q] ? nodes[c.oldNode].children[q] : -1;
+			stack.push_back({ oldChild, quadrantFlux, child, c.depth + 1 });
+		}
+	}
+
+	return result;
+}
+
+SDTree::SDTree(const AABB& sceneBounds) : nodes(1)
+{
+	glm::vec3 extent = sceneBounds.getMax() - sceneBounds.getMin();
+	size = glm::max(glm::max(extent.x, glm::max(extent.y, extent.z)), 1e-3f) * 1.001f;
+	origin = 0.5f * (sceneBounds.getMin() + sceneBounds.getMax()) - glm::vec3(0.5f * size);
+}
+
+int SDTree::lookup(const glm::vec3& p) const
+{
+	glm::vec3 local = glm::clamp((p - origin) / size, glm::vec3(0.0f), glm::vec3(0x1.fffffep-1f));
+	int node = 0;
+
+	while (nodes[node].children[0])
+	{
+		int axis = nodes[node].axis;
+		int side = local[axis] >= 0.5f;
+
+		local[axis] = local[axis] * 2.0f - side;
+		node = nodes[node].children[side];
+	}
+
+	return node;
+}
+
+void SDTree::refine(uint64_t spatialThreshold, float directionalThreshold, size_t memoryLimit)
+{
+	// Directional subdivision stops at 20 levels, about a millionth of the sphere
+	constexpr int MAX_DIRECTIONAL_DEPTH = 20;
+
+	for (spatialNode& node : nodes)
+		node.building.sumUp();
+
+	size_t used = memory();
+
+	// Children start out with what their parent learned and half its samples, and are split
+	// again straight away if that's still too many
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].children[0] || nodes[i].building.getSampleCount() <= spatialThreshold)
+			continue;
+
+		size_t growth = 2 * (sizeof(spatialNode) + nodes[i].building.memory());
+		if (used + growth > memoryLimit)
+			break;
+
+		used += growth;
+
+		int axis = nodes[i].axis;
+		nodes[i].building.halveSamples();
+
+		for (int side = 0; side < 2; side++)
+		{
+			nodes[i].children[side] = (int)nodes.size();
+
+			spatialNode child;
+			child.axis = (axis + 1) % 3;
+			child.building = nodes[i].building;
+
+			nodes.push_back(std::move(child));
+		}
+
+		nodes[i].sampling = DTree();
+		nodes[i].building = DTree();
+	}
+
+	// What each leaf learned becomes what it samples, and its shape the start of the next iteration
+	std::vector<DTree> next;
+	size_t nextMemory = 0;
+
+	for (const spatialNode& node : nodes)
+	{
+		next.push_back(node.children[0] ? DTree() : node.building.refined(directionalThreshold, MAX_DIRECTIONAL_DEPTH));
+		nextMemory += next.back().memory() + node.building.memory();
+	}
+
+	bool grow = nodes.size() * sizeof(spatialNode) + nextMemory <= memoryLimit;
+
+	for (size_t i = 0; i < nodes.size(); i++)
+	{
+		if (nodes[i].children[0])
+			continue;
+
+		// Out of memory, keep learning into the same shape
+		DTree learning = grow ? std::move(next[i]) : nodes[i].building;
+		if (!grow)
+			learning.clear();
+
+		nodes[i].sampling = std::move(nodes[i].building);
+		nodes[i].building = std::move(learning);
+	}
+}
+
+size_t SDTree::memory() const
+{
+	size_t total = nodes.size() * sizeof(spatialNode);
+
+	for (const spatialNode& node : nodes)
+		total += node.sampling.memory() + node.building.memory();
+
+	return total;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ray.h"
+#include "aabb.h"
+#include "sampler.h"
+
+// Distribution of incident radiance over directions, as a quadtree over the unit square. The square
+// maps to the sphere by (cos theta, phi), which preserves area, so a density on the square is the
+// density on the sphere times 4 pi. Workers record into it concurrently; flux is kept in fixed point
+// so the totals don't depend on the order samples land in.
+class DTree
+{
+public:
+	DTree();
+
+	// Add a sample of flux arriving from direction, safe to call concurrently. Only the leaf it
+	// lands in is updated until sumUp().
+	void record(const glm::vec3& direction, float flux);
+
+	// Total up the flux of every interior node from its children, once recording is over
+	void sumUp();
+
+	bool canSample() const { return total() > 0.0; }
+
+	// Only valid when canSample()
+	glm::vec3 sample(Sampler& sampler) const;
+
+	// Solid angle density sample() picks direction with
+	float pdf(const glm::vec3& direction) const;
+
+	// As of the last sumUp()
+	uint64_t getSampleCount() const { return samples; }
+
+	// The same tree with no samples, subdivided wherever a cell holds more than threshold of the
+	// total flux and collapsed wherever it doesn't
+	DTree refined(float threshold, int maxDepth) const;
+
+	// Halve the sample count, for a spatial cell that's just been split in two
+	void halveSamples() { samples /= 2; }
+
+	// Forget every sample but keep the shape
+	void clear();
+
+	size_t memory() const { return nodes.size() * sizeof(quadNode); }
+
+private:
+	struct quadNode
+	{
+		std::array<int64_t, 4> flux{}; // Per quadrant, (x, y) = (q & 1, q >> 1)
+		std::array<uint64_t, 4> samples{}; // Only kept for quadrants that are leaves
+		std::array<int, 4> children{}; // 0 = the quadrant is a leaf
+	};
+
+	double total() const;
+	static double sum(const quadNode& node);
+
+	std::vector<quadNode> nodes;
+	uint64_t samples = 0;
+};
+
+// Spatial binary tree over the scene, each leaf holding a pair of DTrees (Müller et al. 2017): one
+// being sampled from, and one learning from the current training iteration. Leaves are looked up
+// concurrently, but only refine() changes the structure, between passes.
+class SDTree
+{
+public:
+	SDTree(const AABB& sceneBounds);
+
+	// The leaf holding p
+	int lookup(const glm::vec3& p) const;
+
+	const DTree& sampling(int leaf) const { return nodes[leaf].sampling; }
+	DTree& building(int leaf) { return nodes[leaf].building; }
+
+	// End a training iteration: split leaves that saw more than spatialThreshold samples, then make
+	// what every leaf learned its new sampling distribution. The tree stops growing at memoryLimit bytes.
+	void refine(uint64_t spatialThreshold, float directionalThreshold, size_t memoryLimit);
+
+	size_t memory() const;
+
+private:
+	struct spatialNode
+	{
+		std::array<int, 2> children{}; // 0 = leaf
+		int axis = 0;
+
+		DTree sampling;
+		DTree building;
+	};
+
+	std::vector<spatialNode> nodes;
+
+	// A cube around the scene, so splits in the middle of alternating axes keep cells close to cubes
+	glm::vec3 origin;
+	float size;
+};
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include "hobbyraytracer.h"
+#include "socket.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <afunix.h>
+#pragma comment(lib, "ws2_32.lib")
+
+constexpr socket_t NO_SOCKET = INVALID_SOCKET;
+constexpr int SEND_FLAGS = 0;
+
+static void closeSocket(socket_t s) { closesocket(s); }
+static int pollSockets(pollfd* fds, int count, int timeoutMs) { return WSAPoll(fds, count, timeoutMs); }
+
+static bool startup()
+{
+	static bool started = []() {
+		WSADATA data;
+		return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+	}();
+
+	return started;
+}
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+
+constexpr socket_t NO_SOCKET = -1;
+constexpr int SEND_FLAGS = MSG_NOSIGNAL; // Report a closed peer as an error rather than SIGPIPE
+
+static void closeSocket(socket_t s) { ::close(s); }
+static int pollSockets(pollfd* fds, int count, int timeoutMs) { return poll(fds, count, timeoutMs); }
+
+static bool startup() { return true; }
+#endif
+
+Socket::Socket() : handle(NO_SOCKET) { }
+
+Socket::~Socket()
+{
+	close();
+}
+
+Socket::Socket(Socket&& other) noexcept : handle(other.handle)
+{
+	other.handle = NO_SOCKET;
+}
+
+Socket& Socket::operator=(Socket&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		handle = other.handle;
+		other.handle = NO_SOCKET;
+	}
+
+	return *this;
+}
+
+static bool unixAddress(const std::string& path, sockaddr_un& address)
+{
+	address = {};
+	address.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		std::cout << "Socket path too long: " << path << std::endl;
+		return false;
+	}
+
+	std::copy(path.begin(), path.end(), address.sun_path);
+	return true;
+}
+
+Socket Socket::listenUnix(const std::string& path)
+{
+	sockaddr_un address;
+	if (!startup() || !unixAddress(path, address))
+		return Socket();
+
+	Socket s(::socket(AF_UNIX, SOCK_STREAM, 0));
+	if (!s.valid())
+		return Socket();
+
+	std::error_code ec;
+	std::filesystem::remove(path, ec);
+
+	if (bind(s.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| listen(s.handle, 8) != 0)
+	{
+		std::cout << "Could not listen on socket: " << path << std::endl;
+		return Socket();
+	}
+
+	return s;
+}
+
+Socket Socket::connectUnix(const std::string& path)
+{
+	sockaddr_un address;
+	if (!startup() || !unixAddress(path, address))
+		return Socket();
+
+	Socket s(::socket(AF_UNIX, SOCK_STREAM, 0));
+	if (!s.valid())
+		return Socket();
+
+	if (connect(s.handle, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		return Socket();
+
+	return s;
+}
+
+// Resolves host:port, a null host gives the wildcard address for listening
+static addrinfo* resolve(const std::string& host, int port, bool passive)
+{
+	addrinfo hints = {};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+	addrinfo* result = nullptr;
+	std::string service = std::to_string(port);
+
+	if (getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(), &hints, &result) != 0)
+	{
+		std::cout << "Could not resolve: " << host << ":" << port << std::endl;
+		return nullptr;
+	}
+
+	return result;
+}
+
+static void setNoDelay(socket_t s)
+{
+	// Work units are small request/response messages, don't hold them back to batch them
+	int one = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&one), sizeof(one));
+}
+
+Socket Socket::listenTcp(const std::string& host, int port)
+{
+	if (!startup())
+		return Socket();
+
+	addrinfo* addresses = resolve(host, port, true);
+
+	for (addrinfo* a = addresses; a; a = a->ai_next)
+	{
+		Socket s(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+		if (!s.valid())
+			continue;
+
+		int one = 1;
+		setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&one), sizeof(one));
+
+		if (bind(s.handle, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0 && listen(s.handle, 64) == 0)
+		{
+			freeaddrinfo(addresses);
+			return s;
+		}
+	}
+
+	if (addresses) freeaddrinfo(addresses);
+
+	std::cout << "Could not listen on: " << host << ":" << port << std::endl;
+	return Socket();
+}
+
+Socket Socket::connectTcp(const std::string& host, int port)
+{
+	if (!startup())
+		return Socket();
+
+	addrinfo* addresses = resolve(host, port, false);
+
+	for (addrinfo* a = addresses; a; a = a->ai_next)
+	{
+		Socket s(::socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+		if (!s.valid())
+			continue;
+
+		if (connect(s.handle, a->ai_addr, static_cast<int>(a->ai_addrlen)) == 0)
+		{
+			setNoDelay(s.handle);
+			freeaddrinfo(addresses);
+			return s;
+		}
+	}
+
+	if (addresses) freeaddrinfo(addresses);
+
+	return Socket();
+}
+
+// Splits "host:port", returns false for anything that isn't one
+static bool tcpAddress(const std::string& address, std::string& host, int& port)
+{
+	size_t colon = address.rfind(':');
+	if (colon == std::string::npos || colon + 1 == address.size())
+		return false;
+
+	std::string digits = address.substr(colon + 1);
+	if (!std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; }))
+		return false;
+
+	host = address.substr(0, colon);
+	port = std::stoi(digits);
+
+	return true;
+}
+
+Socket Socket::listenOn(const std::string& address)
+{
+	std::string host;
+	int port;
+
+	return tcpAddress(address, host, port) ? listenTcp(host, port) : listenUnix(address);
+}
+
+Socket Socket::connectTo(const std::string& address)
+{
+	std::string host;
+	int port;
+
+	return tcpAddress(address, host, port) ? connectTcp(host, port) : connectUnix(address);
+}
+
+bool Socket::valid() const
+{
+	return handle != NO_SOCKET;
+}
+
+void Socket::close()
+{
+	if (valid())
+	{
+		closeSocket(handle);
+		handle = NO_SOCKET;
+	}
+}
+
+Socket Socket::accept()
+{
+	if (!valid())
+		return Socket();
+
+	Socket s(::accept(handle, nullptr, nullptr));
+
+	// Harmless on Unix sockets, where it simply fails
+	if (s.valid())
+		setNoDelay(s.handle);
+
+	return s;
+}
+
+bool Socket::waitReadable(int timeoutMs)
+{
+	if (!valid())
+		return false;
+
+	pollfd fd = {};
+	fd.fd = handle;
+	fd.events = POLLIN;
+
+	return pollSockets(&fd, 1, timeoutMs) > 0;
+}
+
+bool Socket::sendAll(const void* data, size_t size)
+{
+	const char* p = static_cast<const char*>(data);
+
+	while (size > 0 && valid())
+	{
+		int sent = send(handle, p, static_cast<int>(glm::min<size_t>(size, 1 << 20)), SEND_FLAGS);
+		if (sent <= 0)
+			return false;
+
+		p += sent;
+		size -= sent;
+	}
+
+	return size == 0;
+}
+
+bool Socket::sendLine(const std::string& line)
+{
+	std::string l = line + "\n";
+	return sendAll(l.data(), l.size());
+}
+
+bool Socket::recvAll(void* data, size_t size)
+{
+	char* p = static_cast<char*>(data);
+
+	while (size > 0 && valid())
+	{
+		int received = recv(handle, p, static_cast<int>(glm::min<size_t>(size, 1 << 20)), 0);
+		if (received <= 0)
+			return false;
+
+		p += received;
+		size -= received;
+	}
+
+	return size == 0;
+}
+
+bool Socket::recvLine(std::string& line)
+{
+	line.clear();
+
+	char c;
+	while (recvAll(&c, 1))
+	{
+		if (c == '\n')
+			return true;
+
+		line += c;
+	}
+
+	return false;
+}
\ No newline at end of file
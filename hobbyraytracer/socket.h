@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+#ifdef _WIN32
+using socket_t = uintptr_t;
+#else
+using socket_t = int;
+#endif
+
+// Minimal blocking stream socket, move only. Wraps Winsock and BSD sockets.
+class Socket
+{
+public:
+	Socket();
+	~Socket();
+
+	Socket(Socket&& other) noexcept;
+	Socket& operator=(Socket&& other) noexcept;
+
+	Socket(const Socket&) = delete;
+	Socket& operator=(const Socket&) = delete;
+
+	// Local (Unix domain) sockets, any existing file at path is replaced when listening
+	static Socket listenUnix(const std::string& path);
+	static Socket connectUnix(const std::string& path);
+
+	// TCP, an empty host listens on every interface
+	static Socket listenTcp(const std::string& host, int port);
+	static Socket connectTcp(const std::string& host, int port);
+
+	// "host:port" is TCP, anything else is taken as a Unix socket path
+	static Socket listenOn(const std::string& address);
+	static Socket connectTo(const std::string& address);
+
+	bool valid() const;
+	void close();
+
+	Socket accept();
+
+	// Wait up to timeoutMs for data (or a connection) to arrive
+	bool waitReadable(int timeoutMs);
+
+	bool sendAll(const void* data, size_t size);
+	bool sendLine(const std::string& line);
+
+	bool recvAll(void* data, size_t size);
+	bool recvLine(std::string& line);
+
+private:
+	explicit Socket(socket_t s) : handle(s) { }
+
+	socket_t handle;
+};
\ No newline at end of file
@@ -17,7 +17,7 @@ void Sphere::getSphereUV(const glm::vec3& p, float& u, float& v)
     v = theta / glm::pi<float>();
 }
 
-bool Sphere::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+bool Sphere::intersect(const ray& r, float t_min, float t_max, float& root) const
 {
     glm::vec3 oc = r.o - center;
     float a = glm::length(r.dir) * glm::length(r.dir);
@@ -28,13 +28,22 @@ bool Sphere::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     if (discriminant < 0) return false;
     float sqrtd = sqrtf(discriminant);
 
-    float root = (-half_b - sqrtd) / a;
+    root = (-half_b - sqrtd) / a;
     if (root < t_min || root > t_max) {
         root = (-half_b + sqrtd) / a;
         if (root < t_min || root > t_max)
             return false;
     }
 
+    return true;
+}
+
+bool Sphere::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+{
+    float root;
+    if (!intersect(r, t_min, t_max, root))
+        return false;
+
     rec.t = root;
     rec.p = r.at(rec.t);
 
@@ -44,10 +53,17 @@ bool Sphere::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     getSphereUV(outwardNormal, rec.u, rec.v);
 
     rec.matPtr = matPtr;
+    rec.object = this;
 
     return true;
 }
 
+bool Sphere::occluded(const ray& r, float t_min, float t_max) const
+{
+    float root;
+    return intersect(r, t_min, t_max, root);
+}
+
 bool Sphere::boundingBox(AABB& outputBox)
 {
     outputBox = AABB(
@@ -56,4 +72,19 @@ bool Sphere::boundingBox(AABB& outputBox)
     );
 
     return true;
+}
+
+float Sphere::area() const
+{
+    return 4.0f * glm::pi<float>() * radius * radius;
+}
+
+surfaceSample Sphere::sampleSurface(Sampler& sampler) const
+{
+    surfaceSample sample;
+    sample.normal = randomUnitVector(sampler);
+    sample.p = center + radius * sample.normal;
+    getSphereUV(sample.normal, sample.u, sample.v);
+
+    return sample;
 }
\ No newline at end of file
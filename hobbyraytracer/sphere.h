@@ -9,11 +9,18 @@ public:
 	Sphere(glm::vec3 c, float r, std::shared_ptr<Material> m) : center(c), radius(r), matPtr(m) { }
 
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
     virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual float area() const override;
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
 	static void getSphereUV(const glm::vec3& p, float& u, float& v);
 
 private:
+	// The nearer of the ray's crossings with the sphere inside [t_min, t_max]
+	bool intersect(const ray& r, float t_min, float t_max, float& root) const;
+
 	glm::vec3 center;
 	float radius;
     std::shared_ptr<Material> matPtr;
@@ -0,0 +1,205 @@
+#include "hobbyraytracer.h"
+#include "telemetry.h"
+
+#include <sstream>
+
+Telemetry::Telemetry(int nThreads, uint64_t total, TelemetryOutput out, std::string socketPath)
+	: counters(std::make_unique<ThreadCounters[]>(nThreads)),
+	numThreads(nThreads), totalSamples(total), output(out), running(false)
+{
+	startTime = std::chrono::high_resolution_clock::now();
+
+	if (!socketPath.empty())
+	{
+		server = Socket::listenUnix(socketPath);
+
+		if (server.valid())
+			std::cout << "Telemetry available on: " << socketPath << std::endl;
+	}
+}
+
+Telemetry::~Telemetry()
+{
+	stop();
+}
+
+void Telemetry::flush(int worker, RayStats& stats, uint64_t samples, std::chrono::nanoseconds busy)
+{
+	// Only this worker ever writes its counters, so a relaxed add never contends
+	ThreadCounters& c = counters[worker];
+
+	c.primaryRays.fetch_add(stats.primaryRays, std::memory_order_relaxed);
+	c.secondaryRays.fetch_add(stats.secondaryRays, std::memory_order_relaxed);
+	c.shadowRays.fetch_add(stats.shadowRays, std::memory_order_relaxed);
+	c.shadingEvents.fetch_add(stats.shadingEvents, std::memory_order_relaxed);
+	c.samples.fetch_add(samples, std::memory_order_relaxed);
+	c.busyNanoseconds.fetch_add(busy.count(), std::memory_order_relaxed);
+
+	stats = RayStats();
+}
+
+void Telemetry::start(std::chrono::milliseconds interval)
+{
+	startTime = std::chrono::high_resolution_clock::now();
+	running = true;
+
+	reporter = std::thread([this, interval]() {
+		std::unique_lock<std::mutex> lock(m);
+
+		while (running)
+		{
+			lock.unlock();
+			report();
+			lock.lock();
+
+			cv.wait_for(lock, interval, [this]() { return !running; });
+		}
+	});
+
+	if (server.valid())
+	{
+		listener = std::thread([this]() {
+			while (true)
+			{
+				{
+					std::lock_guard<std::mutex> lock(m);
+					if (!running) break;
+				}
+
+				if (!server.waitReadable(100))
+					continue;
+
+				Socket client = server.accept();
+				if (client.valid())
+				{
+					std::lock_guard<std::mutex> guard(clientMutex);
+					clients.push_back(std::move(client));
+				}
+			}
+		});
+	}
+}
+
+void Telemetry::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (!running)
+			return;
+
+		running = false;
+	}
+
+	cv.notify_all();
+
+	if (reporter.joinable()) reporter.join();
+	if (listener.joinable()) listener.join();
+
+	// One last report so the final numbers are always seen
+	report();
+
+	if (output == TelemetryOutput::Console)
+		std::cout << std::endl;
+}
+
+std::string Telemetry::snapshot() const
+{
+	double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+	elapsed = glm::max(elapsed, 1e-6);
+
+	uint64_t primary = 0, secondary = 0, shadow = 0, shading = 0, samples = 0;
+
+	std::stringstream threads;
+	threads << std::fixed << std::setprecision(3);
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		const ThreadCounters& c = counters[i];
+
+		uint64_t p = c.primaryRays.load(std::memory_order_relaxed);
+		uint64_t s = c.secondaryRays.load(std::memory_order_relaxed);
+		uint64_t o = c.shadowRays.load(std::memory_order_relaxed);
+
+		primary += p;
+		secondary += s;
+		shadow += o;
+		shading += c.shadingEvents.load(std::memory_order_relaxed);
+		samples += c.samples.load(std::memory_order_relaxed);
+
+		double busy = c.busyNanoseconds.load(std::memory_order_relaxed) / 1e9;
+
+		threads << (i > 0 ? "," : "") << "{\"thread\":" << i
+			<< ",\"rays\":" << (p + s + o)
+			<< ",\"utilisation\":" << glm::min(busy / elapsed, 1.0)
+			<< ",\"idle_seconds\":" << glm::max(elapsed - busy, 0.0) << "}";
+	}
+
+	double progress = totalSamples > 0 ? (double)samples / (double)totalSamples : 0.0;
+	double eta = estimateRemaining(elapsed, samples);
+
+	std::stringstream json;
+	json << std::fixed << std::setprecision(3)
+		<< "{\"elapsed\":" << elapsed
+		<< ",\"progress\":" << progress
+		<< ",\"eta\":" << eta
+		<< ",\"samples\":" << samples
+		<< ",\"total_samples\":" << totalSamples
+		<< ",\"primary_rays\":" << primary
+		<< ",\"secondary_rays\":" << secondary
+		<< ",\"shadow_rays\":" << shadow
+		<< ",\"shading_events\":" << shading
+		<< ",\"rays_per_second\":" << (primary + secondary + shadow) / elapsed
+		<< ",\"samples_per_second\":" << samples / elapsed
+		<< ",\"threads\":[" << threads.str() << "]}";
+
+	return json.str();
+}
+
+double Telemetry::estimateRemaining(double elapsed, uint64_t samples) const
+{
+	double eta = samples > 0 ? elapsed * (double)(totalSamples - glm::min(samples, totalSamples)) / (double)samples : -1.0;
+
+	if (deadline)
+	{
+		double budget = std::chrono::duration<double>(*deadline - std::chrono::high_resolution_clock::now()).count();
+		eta = eta < 0.0 ? budget : glm::min(eta, budget);
+	}
+
+	return glm::max(eta, samples > 0 || deadline ? 0.0 : -1.0);
+}
+
+void Telemetry::report()
+{
+	std::string json = snapshot();
+
+	if (output == TelemetryOutput::Json)
+	{
+		std::cout << json << std::endl;
+	}
+	else
+	{
+		double elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - startTime).count();
+		elapsed = glm::max(elapsed, 1e-6);
+
+		uint64_t rays = 0, samples = 0;
+		for (int i = 0; i < numThreads; i++)
+		{
+			rays += counters[i].primaryRays.load(std::memory_order_relaxed) + counters[i].secondaryRays.load(std::memory_order_relaxed)
+				+ counters[i].shadowRays.load(std::memory_order_relaxed);
+			samples += counters[i].samples.load(std::memory_order_relaxed);
+		}
+
+		double eta = glm::max(estimateRemaining(elapsed, samples), 0.0);
+
+		std::cout << "\rSamples: " << samples << "/" << totalSamples
+			<< std::fixed << std::setprecision(2)
+			<< " | " << (rays / elapsed) / 1e6 << " Mrays/s"
+			<< " | ETA " << eta << "s   " << std::defaultfloat << std::flush;
+	}
+
+	std::lock_guard<std::mutex> guard(clientMutex);
+
+	// Drop anyone who has gone away
+	clients.erase(std::remove_if(clients.begin(), clients.end(),
+		[&json](Socket& c) { return !c.sendLine(json); }), clients.end());
+}
\ No newline at end of file
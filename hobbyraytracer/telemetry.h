@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <optional>
+
+#include "socket.h"
+
+// Work done by a single worker. Each set of counters sits on its own cache line and is only
+// written by its worker, readers just take relaxed snapshots - so there is no contention.
+struct alignas(64) ThreadCounters
+{
+	std::atomic<uint64_t> primaryRays = 0;
+	std::atomic<uint64_t> secondaryRays = 0;
+	std::atomic<uint64_t> shadowRays = 0;
+	std::atomic<uint64_t> shadingEvents = 0;
+	std::atomic<uint64_t> samples = 0;
+	std::atomic<uint64_t> busyNanoseconds = 0;
+};
+
+// Counters gathered locally while tracing, flushed into ThreadCounters every so often
+struct RayStats
+{
+	uint64_t primaryRays = 0;
+	uint64_t secondaryRays = 0;
+	uint64_t shadowRays = 0;
+	uint64_t shadingEvents = 0;
+};
+
+enum class TelemetryOutput
+{
+	Console, // Human readable progress line
+	Json // One JSON object per line on stdout
+};
+
+// Periodically reports rays/sec, samples/sec, per thread utilisation and an ETA,
+// to the console, as JSON lines and/or to clients of a local socket
+class Telemetry
+{
+public:
+	Telemetry(int numThreads, uint64_t totalSamples, TelemetryOutput output = TelemetryOutput::Console,
+		std::string socketPath = "");
+	~Telemetry();
+
+	ThreadCounters& getCounters(int worker) { return counters[worker]; }
+
+	void flush(int worker, RayStats& stats, uint64_t samples, std::chrono::nanoseconds busy);
+
+	// Cap the ETA at a wall clock deadline, for time limited renders
+	void setDeadline(std::chrono::high_resolution_clock::time_point d) { deadline = d; }
+
+	void start(std::chrono::milliseconds interval = std::chrono::milliseconds(500));
+	void stop();
+
+	// A single JSON object describing the render right now
+	std::string snapshot() const;
+
+private:
+	void report();
+
+	// Seconds until the render finishes, -1 if there's nothing to go on yet
+	double estimateRemaining(double elapsed, uint64_t samples) const;
+
+	std::unique_ptr<ThreadCounters[]> counters;
+	int numThreads;
+	uint64_t totalSamples;
+
+	TelemetryOutput output;
+
+	std::chrono::high_resolution_clock::time_point startTime;
+	std::optional<std::chrono::high_resolution_clock::time_point> deadline;
+
+	std::thread reporter;
+	std::mutex m;
+	std::condition_variable cv;
+	bool running;
+
+	std::thread listener;
+	Socket server;
+	std::vector<Socket> clients;
+	std::mutex clientMutex;
+};
\ No newline at end of file
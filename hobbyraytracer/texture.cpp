@@ -83,8 +83,9 @@ glm::vec3 EnvironmentMap::colourValue(float u, float v, const glm::vec3& p) cons
 	u = glm::clamp(u, 0.0f, 1.0f);
 	v = glm::clamp(v, 0.0f, 1.0f);  // Flip V to image coordinates
 
-	int i = static_cast<int>((u * (width - 1)) + 0.5f);
-	int j = static_cast<int>((v * (height - 1)) + 0.5f);
+	// Pixel (i, j) covers [i, i + 1) / width, the same cells the sampling distribution uses
+	int i = glm::min(static_cast<int>(u * width), width - 1);
+	int j = glm::min(static_cast<int>(v * height), height - 1);
 
 	glm::vec3 pixel =
 	{
@@ -111,5 +112,73 @@ EnvironmentMap::EnvironmentMap(std::string path)
 
 	stbi_image_free(image);
 
+	// Rows near the poles cover less solid angle, hence sin(theta)
+	std::vector<float> weights((size_t)width * height);
+
+	for (int j = 0; j < height; j++)
+	{
+		float sinTheta = glm::sin(glm::pi<float>() * (j + 0.5f) / height);
+
+		for (int i = 0; i < width; i++)
+		{
+			size_t pixel = (size_t)j * width + i;
+			weights[pixel] = luminance(glm::vec3(data[pixel * channels], data[pixel * channels + 1], data[pixel * channels + 2])) * sinTheta;
+		}
+	}
+
+	distribution = Distribution2D(weights, width, height);
+
 	std::cout << "Loaded environment map: " << path << std::endl;
 }
+
+glm::vec2 EnvironmentMap::directionToUV(const glm::vec3& direction)
+{
+	// Normalize ray direction
+	glm::vec3 nD = glm::normalize(direction);
+
+	// Convert normalized ray direction to polar coordinates
+	float phi = atan2(nD.z, nD.x);
+	float theta = acos(nD.y);
+
+	// Convert polar coordinates to UV coordinates
+	float u = phi / (2 * glm::pi<float>()) + 0.5;
+	float v = theta / glm::pi<float>();
+
+	return glm::vec2(u, v);
+}
+
+glm::vec3 EnvironmentMap::uvToDirection(const glm::vec2& uv)
+{
+	float phi = (uv.x - 0.5f) * 2.0f * glm::pi<float>();
+	float theta = uv.y * glm::pi<float>();
+
+	return glm::vec3(glm::sin(theta) * glm::cos(phi), glm::cos(theta), glm::sin(theta) * glm::sin(phi));
+}
+
+glm::vec3 EnvironmentMap::sampleDirection(Sampler& sampler, float& pdf) const
+{
+	glm::vec2 uv = distribution.sample(sampler, pdf);
+	float sinTheta = glm::sin(uv.y * glm::pi<float>());
+
+	// From density over uv to density over solid angle
+	pdf = sinTheta > 0.0f ? pdf / (2.0f * glm::pi<float>() * glm::pi<float>() * sinTheta) : 0.0f;
+
+	return uvToDirection(uv);
+}
+
+float EnvironmentMap::directionPdf(const glm::vec3& direction) const
+{
+	glm::vec2 uv = directionToUV(direction);
+	float sinTheta = glm::sin(uv.y * glm::pi<float>());
+
+	if (sinTheta <= 0.0f)
+		return 0.0f;
+
+	return distribution.pdf(uv) / (2.0f * glm::pi<float>() * glm::pi<float>() * sinTheta);
+}
+
+float EnvironmentMap::totalLuminance() const
+{
+	// Each cell covers (2pi / width) * (pi / height) of uv, times the sin(theta) already in the weights
+	return (float)(distribution.sum() * 2.0 * glm::pi<double>() * glm::pi<double>() / ((double)width * height));
+}
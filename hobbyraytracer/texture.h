@@ -1,5 +1,7 @@
 #pragma once
 
+#include "distribution.h"
+
 class Texture
 {
 public:
@@ -68,7 +70,23 @@ public:
 	EnvironmentMap() : data(0), width(0), height(0), channels(0) {} 
 	EnvironmentMap(std::string path);
 
+	// The polar layout background lookups use: u around the y axis, v from +y down to -y
+	static glm::vec2 directionToUV(const glm::vec3& direction);
+	static glm::vec3 uvToDirection(const glm::vec2& uv);
+
+	bool canSample() const { return distribution.valid(); }
+
+	// A direction picked in proportion to luminance times solid angle, and its density
+	glm::vec3 sampleDirection(Sampler& sampler, float& pdf) const;
+	float directionPdf(const glm::vec3& direction) const;
+
+	// Luminance integrated over the sphere
+	float totalLuminance() const;
+
 private:
 	std::vector<float> data;
 	int width, height, channels;
+
+	// One cell per pixel, weighted by luminance * sin(theta)
+	Distribution2D distribution;
 };
\ No newline at end of file
@@ -18,6 +18,11 @@ bool Translate::hit(const ray& r, float t_min, float t_max, hitRecord& rec) cons
 	return true;
 }
 
+bool Translate::occluded(const ray& r, float t_min, float t_max) const
+{
+	return ptr->occluded(ray(r.o - offset, r.dir), t_min, t_max);
+}
+
 bool Translate::boundingBox(AABB& outputBox)
 {
 	if (!ptr->boundingBox(outputBox))
@@ -32,3 +37,21 @@ bool Translate::boundingBox(AABB& outputBox)
 
 	return true;
 }
+
+surfaceSample Translate::sampleSurface(Sampler& sampler) const
+{
+	surfaceSample sample = ptr->sampleSurface(sampler);
+	sample.p += offset;
+
+	return sample;
+}
+
+std::vector<std::shared_ptr<Hittable>> Translate::split() const
+{
+	std::vector<std::shared_ptr<Hittable>> pieces;
+
+	for (const auto& piece : ptr->split())
+		pieces.push_back(std::make_shared<Translate>(piece, offset));
+
+	return pieces;
+}
\ No newline at end of file
@@ -10,8 +10,19 @@ public:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual const Hittable* primitive() const override { return ptr->primitive(); }
+
+	virtual float area() const override { return ptr->area(); }
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
+	// The pieces of the object, each moved the same way
+	virtual std::vector<std::shared_ptr<Hittable>> split() const override;
+
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override { return ptr->normalBounds(axis, cosTheta); }
+
 private:
 	std::shared_ptr<Hittable> ptr;
 	glm::vec3 offset;
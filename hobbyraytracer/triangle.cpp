@@ -1,7 +1,7 @@
 #include "hobbyraytracer.h"
 #include "triangle.h"
 
-bool Triangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+bool Triangle::intersect(const ray& r, float t_min, float t_max, float& t, float& u, float& v) const
 {
     glm::vec3 v0v1 = v1 - v0;
     glm::vec3 v0v2 = v2 - v0;
@@ -16,21 +16,33 @@ bool Triangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     float invD = 1.0f / d;
 
     glm::vec3 tV = glm::normalize(r.o - v0);
-    rec.u = glm::dot(tV, pV) * invD;
-    if (rec.u < 0 || rec.u > 1) return false;
+    u = glm::dot(tV, pV) * invD;
+    if (u < 0 || u > 1) return false;
 
     glm::vec3 qV = glm::cross(tV, glm::normalize(v0v1));
-    rec.v = glm::dot(glm::normalize(r.dir), qV) * invD;
-    if (rec.v < 0 || rec.u + rec.v > 1) return false;
+    v = glm::dot(glm::normalize(r.dir), qV) * invD;
+    if (v < 0 || u + v > 1) return false;
+
+    t = glm::dot(v0v2, qV) * invD;
 
-    rec.t = glm::dot(v0v2, qV) * invD;
+    if (t < t_min) return false;
+    if (t > t_max) return false;
+
+    return true;
+}
 
-    if (rec.t < t_min) return false;
-    if (rec.t > t_max) return false;
+bool Triangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+{
+    if (!intersect(r, t_min, t_max, rec.t, rec.u, rec.v))
+        return false;
+
+    glm::vec3 v0v1 = v1 - v0;
+    glm::vec3 v0v2 = v2 - v0;
 
     rec.p = r.at(rec.t);
 
     rec.matPtr = matPtr;
+    rec.object = this;
 
     assert(rec.u + rec.v <= 1);
 
@@ -39,6 +51,12 @@ bool Triangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
     return true;
 }
 
+bool Triangle::occluded(const ray& r, float t_min, float t_max) const
+{
+    float t, u, v;
+    return intersect(r, t_min, t_max, t, u, v);
+}
+
 bool Triangle::boundingBox(AABB& outputBox)
 {
     float minX = glm::min(glm::min(v0.x, v1.x), v2.x);
@@ -54,7 +72,7 @@ bool Triangle::boundingBox(AABB& outputBox)
     return true;
 }
 
-bool ITriangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+bool ITriangle::intersect(const ray& r, float t_max, float& t, glm::vec3& b) const
 {
     // See: https://pbr-book.org/3ed-2018/Shapes/Triangle_Meshes
 
@@ -110,17 +128,24 @@ bool ITriangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) cons
 
     // Compute barycentric coordinates and $t$ value for triangle intersection
     float invDet = 1 / det;
-    float b0 = e0 * invDet;
-    float b1 = e1 * invDet;
-    float b2 = e2 * invDet;
-    float t = tScaled * invDet;
+    b = glm::vec3(e0, e1, e2) * invDet;
+    t = tScaled * invDet;
+
+    return true;
+}
+
+bool ITriangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) const
+{
+    glm::vec3 b;
+    if (!intersect(r, t_max, rec.t, b))
+        return false;
 
-    rec.t = t;
     rec.p = r.at(rec.t);
     rec.matPtr = matPtr;
+    rec.object = this;
     
-    glm::vec3 normal = b0 * normals[0] + b1 * normals[1] + b2 * normals[2];
-    glm::vec2 uv = b0 * uvs[0] + b1 * uvs[1] + b2 * uvs[2];
+    glm::vec3 normal = b[0] * normals[0] + b[1] * normals[1] + b[2] * normals[2];
+    glm::vec2 uv = b[0] * uvs[0] + b[1] * uvs[1] + b[2] * uvs[2];
 
     rec.normal = normal;
 
@@ -130,6 +155,14 @@ bool ITriangle::hit(const ray& r, float t_min, float t_max, hitRecord& rec) cons
     return true;
 }
 
+// Like hit(), t_min isn't checked: the edge and determinant tests already keep t above 0
+bool ITriangle::occluded(const ray& r, float t_min, float t_max) const
+{
+    float t;
+    glm::vec3 b;
+    return intersect(r, t_max, t, b);
+}
+
 bool ITriangle::boundingBox(AABB& outputBox)
 {
     if (bBox.getMax() == bBox.getMin())
@@ -149,3 +182,75 @@ bool ITriangle::boundingBox(AABB& outputBox)
 
     return true;
 }
+
+// Uniform barycentric coordinates (b1, b2) over a triangle
+static glm::vec2 sampleBarycentric(Sampler& sampler)
+{
+    float su = glm::sqrt(sampler.nextFloat());
+    float r2 = sampler.nextFloat();
+
+    return glm::vec2(su * (1.0f - r2), su * r2);
+}
+
+float Triangle::area() const
+{
+    return 0.5f * glm::length(glm::cross(v1 - v0, v2 - v0));
+}
+
+surfaceSample Triangle::sampleSurface(Sampler& sampler) const
+{
+    glm::vec2 b = sampleBarycentric(sampler);
+
+    surfaceSample sample;
+    sample.p = (1.0f - b.x - b.y) * v0 + b.x * v1 + b.y * v2;
+    sample.normal = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    sample.u = b.x;
+    sample.v = b.y;
+
+    return sample;
+}
+
+bool Triangle::normalBounds(glm::vec3& axis, float& cosTheta) const
+{
+    axis = glm::normalize(glm::cross(v1 - v0, v2 - v0));
+    cosTheta = 1.0f;
+
+    return true;
+}
+
+float ITriangle::area() const
+{
+    return 0.5f * glm::length(glm::cross(vertices[1] - vertices[0], vertices[2] - vertices[0]));
+}
+
+surfaceSample ITriangle::sampleSurface(Sampler& sampler) const
+{
+    glm::vec2 b = sampleBarycentric(sampler);
+    float b0 = 1.0f - b.x - b.y;
+
+    // Interpolated like hit() does, so a light sample and a hit on the same spot agree
+    glm::vec2 uv = b0 * uvs[0] + b.x * uvs[1] + b.y * uvs[2];
+
+    surfaceSample sample;
+    sample.p = b0 * vertices[0] + b.x * vertices[1] + b.y * vertices[2];
+    sample.normal = glm::normalize(b0 * normals[0] + b.x * normals[1] + b.y * normals[2]);
+    sample.u = uv.x;
+    sample.v = uv.y;
+
+    return sample;
+}
+
+bool ITriangle::normalBounds(glm::vec3& axis, float& cosTheta) const
+{
+    // Normalised blends of the vertex normals stay inside any cone holding all three
+    glm::vec3 n[3] = { glm::normalize(normals[0]), glm::normalize(normals[1]), glm::normalize(normals[2]) };
+
+    axis = n[0] + n[1] + n[2];
+    if (glm::dot(axis, axis) < 1e-12f)
+        return false;
+
+    axis = glm::normalize(axis);
+    cosTheta = glm::min(glm::dot(axis, n[0]), glm::min(glm::dot(axis, n[1]), glm::dot(axis, n[2])));
+
+    return true;
+}
\ No newline at end of file
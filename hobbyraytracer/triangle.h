@@ -11,9 +11,18 @@ public:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual float area() const override;
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override;
+
 private:
+	// Where the ray crosses the triangle, as its t and barycentric (u, v)
+	bool intersect(const ray& r, float t_min, float t_max, float& t, float& u, float& v) const;
+
 	glm::vec3 v0, v1, v2;
 	std::shared_ptr<Material> matPtr;
 };
@@ -26,9 +35,19 @@ public:
 
 	// Inherited via Hittable
 	virtual bool hit(const ray& r, float t_min, float t_max, hitRecord& rec) const override;
+	virtual bool occluded(const ray& r, float t_min, float t_max) const override;
 	virtual bool boundingBox(AABB& outputBox) override;
 
+	virtual float area() const override;
+	virtual surfaceSample sampleSurface(Sampler& sampler) const override;
+
+	// Bounds the interpolated vertex normals, which is what lights sampled on it use
+	virtual bool normalBounds(glm::vec3& axis, float& cosTheta) const override;
+
 private:
+	// Where the ray crosses the triangle, as its t and barycentric coordinates
+	bool intersect(const ray& r, float t_max, float& t, glm::vec3& b) const;
+
 	std::array<glm::vec3, 3> vertices, normals;
 	std::array<glm::vec2, 3> uvs;
 